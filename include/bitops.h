@@ -1,3 +1,9 @@
+#ifndef BITOPS_H
+#define BITOPS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
 #ifdef CONFIG_64BIT
 #define BITS_PER_LONG 64
 #else
@@ -5,6 +11,7 @@
 #endif /* CONFIG_64BIT */
 
 #define BITS_PER_BYTE           8
+#define BITS_PER_LONG_LONG      64
 #define DIV_ROUND_UP(n,d) (((n) + (d) - 1) / (d))
 
 #define BIT(nr)                 (1U << (nr))
@@ -15,6 +22,7 @@
 #define BIT_ULL_WORD(nr)        ((nr) / BITS_PER_LONG_LONG)
 
 #define BITS_TO_LONGS(nr)       DIV_ROUND_UP(nr, BITS_PER_BYTE * sizeof(long))
+#define BITS_TO_ULLS(nr)        DIV_ROUND_UP(nr, BITS_PER_LONG_LONG)
 
 #define BIT_ULL_MASK(nr)        (1ULL << ((nr) % BITS_PER_LONG_LONG))
 #define BIT_ULL_WORD(nr)        ((nr) / BITS_PER_LONG_LONG)
@@ -35,3 +43,82 @@
 #define NBITS(n) (n==0?0:NBITS32(n))
 
 #define EXTRACT_NBITS(nr, h, l) ((nr&GENMASK(h,l)) >> l)
+
+/*
+ * Bitmaps of @nbits bits stored in BITS_TO_ULLS(@nbits) 64bit words,
+ * bit 0 being the lowest bit of the first word.
+ */
+static inline void set_bit_ull(int nr, uint64_t *map)
+{
+	map[BIT_ULL_WORD(nr)] |= BIT_ULL_MASK(nr);
+}
+
+static inline void clear_bit_ull(int nr, uint64_t *map)
+{
+	map[BIT_ULL_WORD(nr)] &= ~BIT_ULL_MASK(nr);
+}
+
+static inline void fill_bitmap_ull(uint64_t *map, int nbits)
+{
+	int i;
+
+	for (i = 0; i < BIT_ULL_WORD(nbits); i++)
+		map[i] = ~0ULL;
+	if (nbits % BITS_PER_LONG_LONG)
+		map[i] = BIT_ULL_MASK(nbits) - 1;
+}
+
+/* Lowest bit set in both @a and @b, @nbits if there is none */
+static inline int find_first_and_bit_ull(const uint64_t *a,
+		const uint64_t *b, int nbits)
+{
+	int i;
+
+	for (i = 0; i < (int)BITS_TO_ULLS(nbits); i++) {
+		uint64_t word = a[i] & b[i];
+		if (word)
+			return i * BITS_PER_LONG_LONG + __builtin_ctzll(word);
+	}
+	return nbits;
+}
+
+/* Lowest bit set in @map, @nbits if there is none */
+static inline int find_first_bit_ull(const uint64_t *map, int nbits)
+{
+	return find_first_and_bit_ull(map, map, nbits);
+}
+
+/* Atomic variants for bitmaps shared without a lock */
+static inline void set_bit_ull_atomic(int nr, _Atomic uint64_t *map)
+{
+	atomic_fetch_or(&map[BIT_ULL_WORD(nr)], BIT_ULL_MASK(nr));
+}
+
+static inline void clear_bit_ull_atomic(int nr, _Atomic uint64_t *map)
+{
+	atomic_fetch_and(&map[BIT_ULL_WORD(nr)], ~BIT_ULL_MASK(nr));
+}
+
+/* Set the first @nbits bits of @map one word at a time */
+static inline void fill_bitmap_ull_atomic(_Atomic uint64_t *map, int nbits)
+{
+	int i;
+
+	for (i = 0; i < BIT_ULL_WORD(nbits); i++)
+		atomic_store(&map[i], ~0ULL);
+	if (nbits % BITS_PER_LONG_LONG)
+		atomic_store(&map[i], BIT_ULL_MASK(nbits) - 1);
+}
+
+/* Copy @src into @dst one word at a time, the copy is not a snapshot of
+ * the whole bitmap */
+static inline void load_bitmap_ull(uint64_t *dst, _Atomic uint64_t *src,
+		int nbits)
+{
+	int i;
+
+	for (i = 0; i < (int)BITS_TO_ULLS(nbits); i++)
+		dst[i] = atomic_load(&src[i]);
+}
+
+#endif /* BITOPS_H */
@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdatomic.h>
 
 #ifndef OSCFG_H
 #include "os-cfg.h"
@@ -14,6 +15,8 @@
 #include "os-mm.h"
 #endif
 
+#include "list.h"
+
 #define ADDRESS_SIZE 20
 #define OFFSET_LEN 10
 #define FIRST_LV_LEN 5
@@ -32,6 +35,8 @@ enum ins_opcode_t
 	READ,  // Write data to a byte on memory
 	WRITE, // Read data from a byte on memory
 	SYSCALL,
+	READN,  // Read a span of bytes from memory
+	WRITEN, // Fill a span of bytes on memory with the same data
 };
 
 /* instructions executed by the CPU */
@@ -44,10 +49,25 @@ struct inst_t
 	uint32_t arg_3;
 };
 
+/* Instruction decoded for the interpreter, see cpu.c */
+struct op_t
+{
+	const void *handler; // Where run() jumps to execute it
+	uint32_t arg;	     // Size or offset, the CALC instructions from
+			     // here on for CALC
+	uint16_t reg_0;	     // Register indexes, or the byte to write
+	uint16_t reg_1;
+};
+
 struct code_seg_t
 {
 	struct inst_t *text;
+	struct op_t *ops; // Decoded text, NULL until decoded, see cpu.c
 	uint32_t size;
+	uint32_t refs;	  // Processes running it, see loader.c
+	int cached;
+	size_t mapped;	  // Length of the file mapping holding text, 0 if
+			  // text was allocated
 };
 
 struct trans_table_t
@@ -73,29 +93,66 @@ struct page_table_t
 	int size; // Number of row in the first layer
 };
 
+enum proc_state
+{
+	PROC_READY,	// Queued or running
+	PROC_KILLED,	// Its CPU frees it the next time it looks at it
+	PROC_BLOCKED,	// Waiting for the I/O worker to bring a page in
+};
+
+struct sched_rq;
+
 /* PCB, describe information about a process */
 struct pcb_t
 {
 	uint32_t pid;		 // PID
 	uint32_t priority;	 // Default priority, this legacy process based (FIXED)
-	char path[100];
+	char *path;		 // Program it runs, as given in the config
 	struct code_seg_t *code; // Code segment
 	addr_t regs[10];	 // Registers, store address of allocated regions
 	uint32_t pc;		 // Program pointer, point to the next instruction
-	struct queue_t *ready_queue;
-	struct queue_t *running_list;
+	_Atomic uint32_t state;	 // One of enum proc_state
 #ifdef MLQ_SCHED
-	struct queue_t *mlq_ready_queue;
 	// Priority on execution (if supported), on-fly aka. changeable
 	// and this vale overwrites the default priority when it existed
 	uint32_t prio;
+	uint32_t base_prio;	 // Priority it was loaded with
 #endif
+	/* Scheduler bookkeeping, see sched_class.h */
+	struct list_head all_node;	 // On the list of every live process
+	struct list_head rq_node;	 // On a run queue kept as a list
+	struct sched_rq *_Atomic rq;	 // Run queue holding it, NULL if none
+	uint64_t arrival;	 // Slot the process was admitted in
+	uint64_t vruntime;	 // CFS virtual runtime
+	struct pcb_t *cfs_left;	 // CFS skew heap children
+	struct pcb_t *cfs_right;
+	struct pcb_t *cfs_parent; // NULL at the root
+	int32_t last_cpu;	 // CPU that ran it last, -1 if none yet
+	uint32_t nr_migrations;	 // Times it was dispatched on another CPU
+	uint32_t warmup;	 // Slots its next dispatch stalls for
+	/* Real-time class, rt_period is 0 for the other processes */
+	uint32_t rt_period;
+	uint32_t rt_budget;	 // Slots it may run in each period
+	uint32_t rt_left;	 // Budget left in the current period
+	uint32_t rt_missed;	 // Periods that ended with budget left
+	uint64_t rt_deadline;	 // End of the current period
+	int32_t rt_index;	 // Its node in the heap holding it, see sched_rt.c
+	/* Adaptive quantum, 0 until its first slice */
+	uint32_t quantum;	 // Slots of its next slice
+	uint32_t quantum_lo;	 // Shortest and longest slice it was given
+	uint32_t quantum_hi;
+	uint32_t nr_slices;
 #ifdef MM_PAGING
 	struct mm_struct *mm;
 	struct memphy_struct *mram;
 	struct memphy_struct **mswp;
 	struct memphy_struct *active_mswp;
 	uint32_t active_mswp_id;
+	/* Page fault left to the I/O worker, see pgio.h */
+	uint32_t fault_pgn;
+	uint32_t fault_failed;	 // The worker could not bring the page in
+	uint64_t io_done;	 // Slot the worker is done with it
+	struct list_head io_node;
 #endif
 	struct page_table_t *page_table; // Page table
 	uint32_t bp;			 // Break pointer
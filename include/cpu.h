@@ -4,10 +4,19 @@
 
 #include "common.h"
 
+/* Decode the text of [code] for run() and run_local(). Done by the
+ * loader, or on the first instruction otherwise. */
+void decode_code(struct code_seg_t * code);
+
 /* Execute an instruction of a process. Return 0
  * if the instruction is executed successfully.
  * Otherwise, return 1. */
 int run(struct pcb_t * proc);
 
+/* Execute up to [max] of the next instructions of [proc] as long as
+ * they only use the process itself (CALC). Return the number of
+ * instructions executed. */
+int run_local(struct pcb_t * proc, int max);
+
 #endif
 
@@ -0,0 +1,37 @@
+
+#ifndef DES_H
+#define DES_H
+
+#include <stdint.h>
+
+/* Discrete-event engine. Instead of one host thread per device waiting
+ * on the clock, devices are actors whose step function simulates one
+ * time slot. The engine keeps the time each actor runs again in a
+ * priority queue and only visits the slots in which something happens.
+ *
+ * A step returns the number of slots the actor is done for, or one of: */
+#define DES_STOP	0		// The actor has finished
+#define DES_IDLE	UINT64_MAX	// Nothing to do until another actor acts
+
+/* Idle actors are polled again in the slot following any slot in which
+ * some actor did something. A poll that returns DES_IDLE must not have
+ * changed anything another actor can see. */
+typedef uint64_t (*des_step_t)(void * arg);
+
+/* Register an actor. Actors due in the same slot run in the order they
+ * were added. All actors start in slot current_time(). */
+void des_add_actor(des_step_t step, void * arg);
+
+/* Asked after each slot in which some actor did something, whether the
+ * actor of [arg] has to step in [slot] already although it asked for a
+ * later one. Optional, set once the actor is added. */
+typedef int (*des_recall_t)(void * arg, uint64_t slot);
+void des_set_recall(void * arg, des_recall_t recall);
+
+/* Run every actor until it stops. With [nworkers] > 1 the actors due in
+ * a slot are spread on a pool of host threads, like the CPUs of the
+ * lockstep mode their order inside a slot is then not defined. */
+void des_run(int nworkers);
+
+#endif
+
@@ -23,3 +23,8 @@ int liballoc(struct pcb_t *, uint32_t, uint32_t);
 int libfree(struct pcb_t *, uint32_t);
 int libread(struct pcb_t*, uint32_t, uint32_t, uint32_t*);
 int libwrite(struct pcb_t*, BYTE, uint32_t, uint32_t);
+/* Copy whole spans, translating once per page instead of once per byte.
+ * A read into a NULL buffer only brings the pages of the span in. */
+int libread_range(struct pcb_t*, uint32_t, uint32_t, BYTE*, uint32_t);
+int libwrite_range(struct pcb_t*, const BYTE*, uint32_t, uint32_t, uint32_t);
+int libfill_range(struct pcb_t*, BYTE, uint32_t, uint32_t, uint32_t);
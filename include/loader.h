@@ -3,7 +3,41 @@
 
 #include "common.h"
 
+/* Binary programs, made from the text ones by proc2bin: a header then
+ * [size] packed inst_t records in host byte order. The loader maps the
+ * file and runs the records in place. */
+#define PROG_MAGIC "OSPB"
+#define PROG_VERSION 1
+
+struct prog_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t priority;
+	uint32_t size;
+};
+
+/* Processes loaded from the same unchanged file share one code
+ * segment, parsed once */
 struct pcb_t * load(const char * path);
 
+/* Parse stage of the loader: parse the programs at [paths], in order,
+ * on [nthreads] host threads while the simulation runs. load() then
+ * only waits for a program still being parsed. */
+void loader_prefetch(char * const * paths, int n, int nthreads);
+
+/* Free a process created by load() */
+void unload(struct pcb_t * proc);
+
+void loader_stats(void);
+
+/* Read the program at [path], text or binary, bypassing the cache */
+struct code_seg_t * load_code(const char * path, uint32_t * priority);
+
+void free_code(struct code_seg_t * code);
+
+/* Write [code] to [path] as a binary program */
+int save_program(const char * path, uint32_t priority,
+		const struct code_seg_t * code);
+
 #endif
 
@@ -25,6 +25,7 @@
 /* PTE BIT PRESENT */
 #define PAGING_PTE_SET_PRESENT(pte) (pte=pte|PAGING_PTE_PRESENT_MASK)
 #define PAGING_PAGE_PRESENT(pte) (pte&PAGING_PTE_PRESENT_MASK)
+#define PAGING_PAGE_SWAPPED(pte) (pte&PAGING_PTE_SWAPPED_MASK)
 
 /* USRNUM */
 #define PAGING_PTE_USRNUM_LOBIT 15
@@ -142,6 +143,7 @@ int validate_overlap_vm_area(struct pcb_t *caller, int vmaid, int vmastart, int
 int get_free_vmrg_area(struct pcb_t *caller, int vmaid, int size, struct vm_rg_struct *newrg);
 int inc_vma_limit(struct pcb_t *caller, int vmaid, int inc_sz);
 int find_victim_page(struct mm_struct* mm, int *pgn);
+int pg_swapin(struct mm_struct *mm, int pgn, struct pcb_t *caller);
 struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid);
 
 /* MEM/PHY protypes */
@@ -149,6 +151,9 @@ int MEMPHY_get_freefp(struct memphy_struct *mp, int *fpn);
 int MEMPHY_put_freefp(struct memphy_struct *mp, int fpn);
 int MEMPHY_read(struct memphy_struct * mp, int addr, BYTE *value);
 int MEMPHY_write(struct memphy_struct * mp, int addr, BYTE data);
+int MEMPHY_read_range(struct memphy_struct * mp, int addr, BYTE *buf, int size);
+int MEMPHY_write_range(struct memphy_struct * mp, int addr, const BYTE *buf, int size);
+int MEMPHY_fill_range(struct memphy_struct * mp, int addr, BYTE value, int size);
 int MEMPHY_dump(struct memphy_struct * mp);
 int init_memphy(struct memphy_struct *mp, int max_size, int randomflg);
 
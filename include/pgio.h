@@ -0,0 +1,27 @@
+#ifndef PGIO_H
+#define PGIO_H
+
+#include "common.h"
+
+/* Asynchronous page faults. With a latency set, a process that touches
+ * a page in swap does not bring it in on its CPU: it is blocked and its
+ * request is queued to a single I/O worker, which serves the requests
+ * in order, [latency] slots each. The process is ready again once its
+ * page is in, and runs the faulting instruction again. */
+
+/* 0 keeps the page faults synchronous */
+void pgio_set_latency(int slots);
+
+int pgio_async(void);
+
+/* Queue the page fault of [proc], which pg_getpage() blocked. Called by
+ * its CPU once it stopped running it. */
+void pgio_submit(struct pcb_t * proc);
+
+/* Serve the requests due by [now] and make their processes ready.
+ * Return the slot the next one is due, TIMER_NEVER if none is queued. */
+uint64_t pgio_run(uint64_t now);
+
+void pgio_stats(void);
+
+#endif
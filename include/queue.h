@@ -3,15 +3,18 @@
 #define QUEUE_H
 
 #include "common.h"
+#include <stdatomic.h>
 
-#define MAX_QUEUE_SIZE 10
+/* Capacity of a queue the first time it grows, always a power of two */
+#define QUEUE_INIT_SIZE 8
 
+/* FIFO of processes in a ring buffer that doubles when full. A zeroed
+ * struct is an empty queue. */
 struct queue_t {
-	struct pcb_t * proc[MAX_QUEUE_SIZE];
+	struct pcb_t ** proc;
+	int head;	// Index of the oldest process
 	int size;
-	#ifdef MLQ_SCHED
-	int time_slot;
-	#endif
+	int cap;
 };
 
 void enqueue(struct queue_t * q, struct pcb_t * proc);
@@ -20,5 +23,66 @@ struct pcb_t * dequeue(struct queue_t * q);
 
 int empty(struct queue_t * q);
 
+/* Release the buffer of [q], the processes in it are left alone */
+void free_queue(struct queue_t * q);
+
+/* Processes ordered by priority, the lowest value first and the oldest
+ * first among equals. A binary min-heap keyed on (priority, arrival
+ * number). A zeroed struct is an empty queue. */
+struct pq_node {
+	struct pcb_t * proc;
+	uint64_t seq;	// Arrival number, keeps equal priorities FIFO
+};
+
+struct pqueue_t {
+	struct pq_node * heap;
+	int size;
+	int cap;
+	uint64_t seq;	// Arrival number of the next process
+};
+
+void pq_enqueue(struct pqueue_t * q, struct pcb_t * proc);
+
+struct pcb_t * pq_dequeue(struct pqueue_t * q);
+
+int pq_empty(struct pqueue_t * q);
+
+void pq_free(struct pqueue_t * q);
+
+/* Bounded multi-producer multi-consumer FIFO that never takes a lock.
+ * Each cell carries a sequence number telling whether it is free for
+ * the producer at a position or full for the consumer at a position, so
+ * a producer and a consumer only race for the head or the tail index.
+ * The capacity is fixed at lfq_init(). */
+struct lfq_cell {
+	_Atomic uint64_t seq;
+	struct pcb_t * proc;
+};
+
+struct lfq_t {
+	struct lfq_cell * cell;
+	uint64_t mask;
+	/* Keep the two ends on their own cache lines */
+	_Alignas(64) _Atomic uint64_t tail;	// Next position to fill
+	_Alignas(64) _Atomic uint64_t head;	// Next position to take
+};
+
+/* Room for at least [cap] processes */
+void lfq_init(struct lfq_t * q, int cap);
+
+/* Return -1 if [q] is full */
+int lfq_push(struct lfq_t * q, struct pcb_t * proc);
+
+/* Return NULL if [q] is empty */
+struct pcb_t * lfq_pop(struct lfq_t * q);
+
+/* The process lfq_pop() would return, left in [q]. Another consumer may
+ * take it right after. */
+struct pcb_t * lfq_peek(struct lfq_t * q);
+
+int lfq_empty(struct lfq_t * q);
+
+void lfq_free(struct lfq_t * q);
+
 #endif
 
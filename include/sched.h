@@ -1,5 +1,5 @@
-#ifndef QUEUE_H
-#define QUEUE_H
+#ifndef SCHED_H
+#define SCHED_H
 
 #include "common.h"
 
@@ -11,9 +11,112 @@
 
 int queue_empty(void);
 
+/* Give each of the [ncpus] CPUs its own run queue, idle CPUs steal from
+ * the busiest one. Must be called before init_scheduler(). */
+void sched_use_percpu(int ncpus);
+
+/* Number of CPUs, bounds the admission of real-time processes */
+void sched_set_nr_cpus(int ncpus);
+
+/* Tell the scheduler which CPU the calling thread is simulating */
+void sched_set_cpu(int cpu);
+
+/* Select the policy by name, "mlq" (the default), "mlq_lf", "cfs" or
+ * "fifo". Must be called before init_scheduler(). Return -1 if there is
+ * no such policy. */
+int sched_set_policy(const char * name);
+
+/* Most processes queued at once, for the policies with fixed-size
+ * queues. Must be called before init_scheduler(). */
+void sched_set_capacity(int nprocs);
+
+/* Make a CPU stall for [slots] before running a process that ran on
+ * another CPU last, and prefer processes that ran on the same CPU */
+void sched_set_migration_cost(int slots);
+
+/* Balance the per-CPU run queues every [interval] slots when their
+ * loads differ by more than [threshold] percent of the average, -1
+ * keeps the current threshold. 0 turns balancing off. */
+void sched_set_balance(int interval, int threshold);
+
+/* Whether the selected policy wants per-CPU run queues by default */
+int sched_policy_percpu(void);
+
+/* Adapt the slice of each process to how it used the last one, within
+ * [min, max] slots: a process that runs its whole slice gets a longer
+ * one at a lower priority, a process that spends it mostly on system
+ * calls and memory gets a shorter one at a higher priority. The
+ * priority stays within [spread] levels of the one it was loaded with.
+ * A [max] of 0 turns it off, every slice is then the configured one. */
+void sched_set_quantum(int min, int max, int spread);
+
+/* Slots [proc] may run once dispatched, [slot] is the configured time
+ * slot */
+int sched_quantum(struct pcb_t * proc, int slot);
+
+/* The slice of [proc] ended after [ran] slots, [io] of which were
+ * system calls or memory instructions. [expired] tells whether it used
+ * the whole slice. */
+void sched_slice_end(struct pcb_t * proc, int ran, int io, int expired);
+
+/* Admit [proc], whose rt_period and rt_budget are set, as a real-time
+ * process. Return -1 and make it an ordinary process if the CPUs cannot
+ * give it its budget on top of the real-time processes already there. */
+int sched_rt_admit(struct pcb_t * proc);
+
+/* Whether the CPU running [proc] should put it back and dispatch again:
+ * a real-time process with an earlier deadline is ready, or [proc] is a
+ * real-time process out of budget */
+int sched_preempt(struct pcb_t * proc);
+
+/* Tell the scheduler [proc] ran [ticks] slots on the calling CPU */
+void sched_tick(struct pcb_t * proc, int ticks);
+
+/* Charge [proc] for [ticks] slots like sched_tick(), without running the
+ * periodic work that is due */
+void sched_account(struct pcb_t * proc, int ticks);
+
+/* How many of the [max] slots after the current one [proc] may run
+ * without the scheduler looking at it in between: none for a real-time
+ * process, and never up to a balancing pass or to the release of a
+ * real-time process */
+int sched_batch(struct pcb_t * proc, int max);
+
+/* Whether a batch that runs until slot [end] now goes past a balancing
+ * pass or the release of a real-time process, one that became known
+ * after sched_batch() gave it */
+int sched_batch_over(uint64_t end);
+
+/* Take a ready process out of the run queues, return 0 if it was not
+ * queued or the policy cannot take it out */
+int sched_remove(struct pcb_t * proc);
+
+/* Mark [proc] killed. A process left running or queued is freed by the
+ * CPU that looks at it next. */
+void sched_kill(struct pcb_t * proc);
+
+/* Block the running [proc] until sched_wake(), it counts as queued in
+ * the meantime. Return -1 if it was killed. */
+int sched_block(struct pcb_t * proc);
+
+/* Make the blocked [proc] ready again, or hand it to a CPU to be freed
+ * if it was killed in the meantime */
+void sched_wake(struct pcb_t * proc);
+
+/* Call [fn] on every live process. [fn] must not add or finish
+ * processes. */
+void sched_for_each_proc(void (*fn)(struct pcb_t *, void *), void * arg);
+
+/* Tell the scheduler [proc] has finished or was killed, before it is
+ * freed */
+void sched_proc_exit(struct pcb_t * proc);
+
 void init_scheduler(void);
 void finish_scheduler(void);
 
+/* Dispatch, migration, lock contention and per-process statistics */
+void print_sched_stats(void);
+
 /* Get the next process from ready queue */
 struct pcb_t * get_proc(void);
 
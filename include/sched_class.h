@@ -0,0 +1,136 @@
+#ifndef SCHED_CLASS_H
+#define SCHED_CLASS_H
+
+#include "sched.h"
+#include "queue.h"
+#include "bitops.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* Interface between the scheduler core in sched.c and the policies. The
+ * core owns the run queues, their locks and the process counts; a
+ * policy only orders the processes inside one run queue. */
+
+/* State of each policy inside a run queue */
+struct mlq_rq {
+    struct list_head queue[MAX_PRIO];   // Threaded through pcb_t.rq_node
+    /* Dispatches left on each level. They are only valid when the epoch
+     * of the level is the current one, a refill just starts a new epoch
+     * and the levels get their budget back when next served. */
+    int time_slot[MAX_PRIO];
+    unsigned long slot_epoch[MAX_PRIO];
+    unsigned long epoch;
+    /* Levels with at least one ready process and levels with time slots
+     * left, the next level to serve is the first one set in both */
+    uint64_t ready_map[BITS_TO_ULLS(MAX_PRIO)];
+    uint64_t budget_map[BITS_TO_ULLS(MAX_PRIO)];
+    unsigned long nr_refill;
+    /* Per level: dispatches, and epochs that ended with the budget used
+     * up, to tune the size of the budgets */
+    unsigned long nr_served[MAX_PRIO];
+    unsigned long nr_spent[MAX_PRIO];
+};
+
+struct cfs_rq {
+    struct pcb_t * root;            // Skew heap ordered by vruntime
+    uint64_t min_vruntime;          // Never goes backward
+};
+
+struct fifo_rq {
+    struct list_head queue;         // Threaded through pcb_t.rq_node
+};
+
+/* Lock-free MLQ, the levels are allocated on first use */
+struct mlq_lf_rq {
+    struct lfq_t * _Atomic level[MAX_PRIO];
+    _Atomic uint32_t epoch;             // Budget refills so far, plus one
+    _Atomic uint64_t time_slot[MAX_PRIO]; // Epoch << 32 | slots left
+    _Atomic uint64_t ready_map[BITS_TO_ULLS(MAX_PRIO)];
+    _Atomic uint64_t budget_map[BITS_TO_ULLS(MAX_PRIO)];
+    _Atomic unsigned long nr_refill;
+};
+
+/* A run queue. All the CPUs share a single one unless the per-CPU mode
+ * is on, then each CPU owns one and steals when it runs dry. */
+struct sched_rq {
+    pthread_mutex_t lock;
+    struct mlq_rq mlq;
+    struct cfs_rq cfs;
+    struct fifo_rq fifo;
+    struct mlq_lf_rq mlq_lf;
+    _Atomic int nr_ready;
+    _Atomic long load;              // Sum of SCHED_WEIGHT() of the ready
+    /* Statistics */
+    unsigned long nr_locks;
+    unsigned long nr_contended;     // Lock acquisitions that had to wait
+    _Atomic unsigned long nr_dispatch;
+    unsigned long nr_stolen;        // Processes taken from another queue
+    unsigned long nr_pulled;        // Processes the balancer moved here
+};
+
+/* Share of a CPU a process is entitled to, the same scale as the MLQ
+ * time slots */
+#define SCHED_WEIGHT(proc) (MAX_PRIO - (proc)->prio)
+
+/* How many of the best candidates pick_next() looks at for one that ran
+ * on the same CPU */
+#define AFFINITY_WINDOW 4
+
+/* Flags of enqueue() */
+#define ENQUEUE_NEW     1           // First time the process is queued
+
+/* A scheduling policy. Every hook but on_tick and stats is called with
+ * the lock of [rq] held, unless the policy is lockless: then the run
+ * queue lock is never taken and the hooks may run concurrently. */
+struct sched_class {
+    const char * name;
+    int percpu;                     // Wants per-CPU run queues by default
+    int lockless;
+    void (*init)(struct sched_rq * rq);
+    void (*fini)(struct sched_rq * rq);
+    void (*enqueue)(struct sched_rq * rq, struct pcb_t * proc, int flags);
+    /* The next process to run on [cpu], NULL if there is none right
+     * now. A policy may pass over a better process for one that ran on
+     * [cpu] last, [cpu] is -1 when there is no point. */
+    struct pcb_t * (*pick_next)(struct sched_rq * rq, int cpu);
+    /* The process [to] should take from [rq], NULL if none */
+    struct pcb_t * (*steal)(struct sched_rq * rq, struct sched_rq * to);
+    /* The process steal() would take next, left where it is */
+    struct pcb_t * (*peek)(struct sched_rq * rq);
+    /* [proc] ran [ticks] slots on a CPU of [rq], optional */
+    void (*on_tick)(struct sched_rq * rq, struct pcb_t * proc, int ticks);
+    /* Take [proc] out of [rq], where it is known to be. Return 0 if it
+     * could not be found. NULL if the queues cannot give up a process
+     * from the middle: it stays there until a CPU takes it. */
+    int (*remove)(struct sched_rq * rq, struct pcb_t * proc);
+    /* Print the policy counters of [rq], optional */
+    void (*stats)(struct sched_rq * rq);
+};
+
+extern const struct sched_class fifo_sched_class;
+#ifdef MLQ_SCHED
+extern const struct sched_class mlq_sched_class;
+extern const struct sched_class mlq_lf_sched_class;
+extern const struct sched_class cfs_sched_class;
+#endif
+
+/* Real-time tier above the policies, see sched_rt.c. rt_admit() clears
+ * the period of a process it turns down. */
+int rt_admit(struct pcb_t * proc, int ncpus);
+void rt_enqueue(struct pcb_t * proc, int flags);
+struct pcb_t * rt_pick(void);
+void rt_tick(struct pcb_t * proc, int ticks);
+int rt_preempt(struct pcb_t * proc);
+int rt_pending(void);
+/* Slot the first throttled real-time process gets a new budget in,
+ * UINT64_MAX if there is none */
+uint64_t rt_release_time(void);
+int rt_remove(struct pcb_t * proc);
+void rt_exit(struct pcb_t * proc);
+void rt_fini(void);
+void rt_stats(void);
+
+/* Most processes the run queues may hold at once */
+int sched_capacity(void);
+
+#endif
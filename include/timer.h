@@ -1,18 +1,26 @@
+
 #ifndef TIMER_H
 #define TIMER_H
 
 #include <pthread.h>
 #include <stdint.h>
 
+/* A device taking part in the simulated clock. Every attached device
+ * must call next_slot() once per time slot (or detach_event() when it
+ * has nothing left to do) before the clock moves on. */
 struct timer_id_t {
-	int done;
-	int fsh;
-	pthread_cond_t event_cond;
-	pthread_mutex_t event_lock;
-	pthread_cond_t timer_cond;
-	pthread_mutex_t timer_lock;
+	int fsh;	// The device has detached from the clock
+	uint64_t wake;	// First slot an idle device has work again
+	uint64_t resume;	// Slot an away device rejoins the barrier, 0 if here
+	/* Asked in each slot while the device is away, whether it has to
+	 * rejoin the barrier in [slot] already. Optional, see set_recall() */
+	int (*recall)(void * arg, uint64_t slot);
+	void * recall_arg;
 };
 
+/* Wake time of an idle device that only reacts to the other devices */
+#define TIMER_NEVER UINT64_MAX
+
 void start_timer();
 
 void stop_timer();
@@ -23,6 +31,27 @@ void detach_event(struct timer_id_t * event);
 
 void next_slot(struct timer_id_t* timer_id);
 
+/* Same as next_slot() but tells the timer this device did nothing in the
+ * current slot and has nothing to do before [wake]. When every device
+ * is idle the clock jumps straight to the earliest wake time. */
+void next_slot_idle(struct timer_id_t* timer_id, uint64_t wake);
+
+/* Tell the timer this device is done with the current slot and the
+ * [nslots] - 1 slots after it. The device leaves the barrier and only
+ * rejoins it when the clock reaches current_time() + [nslots]. */
+void next_slots(struct timer_id_t* timer_id, uint64_t nslots);
+
+/* Let [recall]([arg], slot) cut the next_slots() of this device short.
+ * It is called by the device releasing a slot, while every other device
+ * is waiting. */
+void set_recall(struct timer_id_t* timer_id,
+		int (*recall)(void * arg, uint64_t slot), void * arg);
+
 uint64_t current_time();
 
+/* Move the clock to [now] without waiting for anybody. Only for engines
+ * that run the devices themselves, see des.h */
+void set_current_time(uint64_t now);
+
 #endif
+
@@ -0,0 +1,32 @@
+#ifndef TLB_H
+#define TLB_H
+
+#include "common.h"
+
+/* Software TLB of each simulated CPU, caching the page to frame
+ * translations of pg_getval() and pg_setval(). An entry is tagged with
+ * the pid of its process, so a context switch keeps the entries of the
+ * other processes instead of flushing them. A page table entry that
+ * stops mapping a frame must be shot down on every CPU. */
+
+/* Give [ncpus] CPUs an empty TLB, with a miss modeled to cost [walk]
+ * cycles against 1 for a hit. [walk] 0 leaves the TLBs off. */
+void tlb_init(int ncpus, int walk);
+
+void tlb_fini(void);
+
+/* TLB used by the calling thread, -1 for none */
+void tlb_set_cpu(int cpu);
+
+/* Frame of page [pgn] of process [pid] in [fpn]. Return 0 on a hit,
+ * -1 on a miss or when the thread has no TLB. */
+int tlb_lookup(uint32_t pid, int pgn, int * fpn);
+
+void tlb_insert(uint32_t pid, int pgn, int fpn);
+
+/* Drop page [pgn] of process [pid] from the TLB of every CPU */
+void tlb_shootdown(uint32_t pid, int pgn);
+
+void tlb_stats(void);
+
+#endif
@@ -0,0 +1,204 @@
+
+/*
+ * Instruction dispatch throughput of the CPU.
+ *
+ * Every program in input/proc is loaded and run from its first to its
+ * last instruction over and over. The memory and system call handlers
+ * are stubbed out below, so the numbers are the cost of dispatching the
+ * instructions. run() and run_local() of cpu.c are measured against the
+ * run() of the baseline tree, which is kept here verbatim, both one
+ * instruction per call like a CPU without batching and with the CALC
+ * runs batched like "batch K". The baseline run() has no READN and
+ * WRITEN and only fails them.
+ *
+ * Usage: bench_cpu [instructions per program]
+ */
+
+#include "cpu.h"
+#include "loader.h"
+#include "mem.h"
+#include "libmem.h"
+#include "syscall.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_INSNS 20000000L
+#define PROC_DIR "input/proc"
+
+/* ----- Stubs of the handlers ----- */
+
+static volatile unsigned long nr_calls;
+
+addr_t alloc_mem(uint32_t size, struct pcb_t * proc) { nr_calls++; return 0; }
+int free_mem(addr_t address, struct pcb_t * proc) { nr_calls++; return 0; }
+int read_mem(addr_t address, struct pcb_t * proc, BYTE * data) { nr_calls++; return 0; }
+int write_mem(addr_t address, struct pcb_t * proc, BYTE data) { nr_calls++; return 0; }
+int liballoc(struct pcb_t * proc, uint32_t size, uint32_t reg_index) { nr_calls++; return 0; }
+int libfree(struct pcb_t * proc, uint32_t reg_index) { nr_calls++; return 0; }
+int libread(struct pcb_t * proc, uint32_t source, uint32_t offset,
+		uint32_t * destination) { nr_calls++; return 0; }
+int libwrite(struct pcb_t * proc, BYTE data, uint32_t destination,
+		uint32_t offset) { nr_calls++; return 0; }
+int libread_range(struct pcb_t * proc, uint32_t source, uint32_t offset,
+		BYTE * buf, uint32_t size) { nr_calls++; return 0; }
+int libwrite_range(struct pcb_t * proc, const BYTE * buf,
+		uint32_t destination, uint32_t offset,
+		uint32_t size) { nr_calls++; return 0; }
+int libfill_range(struct pcb_t * proc, BYTE value, uint32_t destination,
+		uint32_t offset, uint32_t size) { nr_calls++; return 0; }
+int libsyscall(struct pcb_t * proc, uint32_t nr, uint32_t a1, uint32_t a2,
+		uint32_t a3) { nr_calls++; return 0; }
+
+/* ----- Legacy interpreter ----- */
+
+int calc(struct pcb_t *proc); /* cpu.c */
+
+static int legacy_run(struct pcb_t *proc)
+{
+	/* Check if Program Counter point to the proper instruction */
+	if (proc->pc >= proc->code->size)
+	{
+		return 1;
+	}
+
+	struct inst_t ins = proc->code->text[proc->pc];
+	proc->pc++;
+	int stat = 1;
+switch (ins.opcode)
+	{
+	case CALC:
+		stat = calc(proc);
+		break;
+	case ALLOC:
+#ifdef MM_PAGING
+		stat = liballoc(proc, ins.arg_0, ins.arg_1);
+#else
+		stat = alloc(proc, ins.arg_0, ins.arg_1);
+#endif
+		break;
+	case FREE:
+#ifdef MM_PAGING
+		stat = libfree(proc, ins.arg_0);
+#else
+		stat = free_data(proc, ins.arg_0);
+#endif
+		break;
+	case READ:
+#ifdef MM_PAGING
+		stat = libread(proc, ins.arg_0, ins.arg_1, &ins.arg_2);
+#else
+		stat = read(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+#endif
+		break;
+	case WRITE:
+#ifdef MM_PAGING
+		stat = libwrite(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+#else
+		stat = write(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+#endif
+		break;
+	case SYSCALL:
+		stat = libsyscall(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
+		break;
+	default:
+		stat = 1;
+	}
+	return stat;
+}
+
+/* The baseline has no batching, a batch of K slots is K calls */
+static int legacy_run_local(struct pcb_t *proc, int max)
+{
+	int n = 0;
+	while (n < max && proc->pc < proc->code->size &&
+	       proc->code->text[proc->pc].opcode == CALC)
+	{
+		legacy_run(proc);
+		n++;
+	}
+	return n;
+}
+
+/* ----- Benchmark ----- */
+
+enum mode { LEGACY, CURRENT, LEGACY_BATCH, CURRENT_BATCH };
+
+static double now_sec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Instructions per second running [proc] for about [insns] of them */
+static double measure(struct pcb_t * proc, enum mode mode, long insns) {
+	uint32_t size = proc->code->size;
+	long done = 0;
+	double start = now_sec();
+
+	while (done < insns) {
+		proc->pc = 0;
+		while (proc->pc < size) {
+			switch (mode) {
+			case LEGACY:
+				legacy_run(proc);
+				break;
+			case CURRENT:
+				run(proc);
+				break;
+			case LEGACY_BATCH:
+				if (legacy_run_local(proc, size) == 0) {
+					legacy_run(proc);
+				}
+				break;
+			case CURRENT_BATCH:
+				if (run_local(proc, size) == 0) {
+					run(proc);
+				}
+				break;
+			}
+		}
+		done += size;
+	}
+	return done / (now_sec() - start);
+}
+
+int main(int argc, char * argv[]) {
+	long insns = (argc > 1) ? atol(argv[1]) : DEFAULT_INSNS;
+	struct dirent ** names;
+	char path[300];
+	int n, i;
+
+	n = scandir(PROC_DIR, &names, NULL, alphasort);
+	if (n < 0) {
+		printf("Cannot open %s, run from the top of the tree\n", PROC_DIR);
+		return 1;
+	}
+	printf("%-8s %14s %14s %8s %14s %14s %8s\n", "program",
+		"legacy ins/s", "cpu.c ins/s", "speedup",
+		"batched old", "batched new", "speedup");
+	for (i = 0; i < n; i++) {
+		struct pcb_t * proc;
+		double legacy, current, legacy_batch, current_batch;
+
+		if (names[i]->d_name[0] == '.') {
+			free(names[i]);
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s/%s", PROC_DIR, names[i]->d_name);
+		proc = load(path);
+		legacy = measure(proc, LEGACY, insns);
+		current = measure(proc, CURRENT, insns);
+		legacy_batch = measure(proc, LEGACY_BATCH, insns);
+		current_batch = measure(proc, CURRENT_BATCH, insns);
+		printf("%-8s %14.0f %14.0f %7.2fx %14.0f %14.0f %7.2fx\n",
+			names[i]->d_name, legacy, current, current / legacy,
+			legacy_batch, current_batch, current_batch / legacy_batch);
+		fflush(stdout);
+		free(names[i]);
+	}
+	free(names);
+	return 0;
+}
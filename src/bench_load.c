@@ -0,0 +1,101 @@
+/*
+ * Program load time, text against binary.
+ *
+ * A program of n instructions mixing every opcode is written in the text
+ * format of input/proc, then converted to the binary format. Both are
+ * loaded over and over through load_code(), which bypasses the cache of
+ * load() so that every load reads the file: fscanf() for the text one,
+ * mmap() for the binary one. Finding the CALC runs of the text is part
+ * of both.
+ *
+ * Usage: bench_load [instructions per program]
+ */
+
+#include "loader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_INSNS 100000
+#define MIN_SECONDS 0.5
+
+static double now_sec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void write_text(const char * path, int n) {
+	FILE * file = fopen(path, "w");
+	int i;
+
+	fprintf(file, "1 %d\n", n);
+	for (i = 0; i < n; i++) {
+		switch (i % 8) {
+		case 0:
+			fprintf(file, "alloc %d %d\n", 100 + i % 300, i % 10);
+			break;
+		case 1:
+			fprintf(file, "write %d %d %d\n", i % 256, i % 10, i % 100);
+			break;
+		case 2:
+			fprintf(file, "read %d %d %d\n", i % 10, i % 100, i % 10);
+			break;
+		case 3:
+			fprintf(file, "free %d\n", i % 10);
+			break;
+		case 4:
+			fprintf(file, "syscall 17 %d %d\n", i % 10, i % 100);
+			break;
+		default:
+			fprintf(file, "calc\n");
+		}
+	}
+	fclose(file);
+}
+
+/* Seconds per load of [path] */
+static double measure(const char * path) {
+	struct code_seg_t * code;
+	uint32_t priority;
+	double start = now_sec(), elapsed;
+	long loads = 0;
+
+	do {
+		code = load_code(path, &priority);
+		free_code(code);
+		loads++;
+	} while ((elapsed = now_sec() - start) < MIN_SECONDS);
+	return elapsed / loads;
+}
+
+int main(int argc, char * argv[]) {
+	int n = (argc > 1) ? atoi(argv[1]) : DEFAULT_INSNS;
+	char text[] = "/tmp/bench_load_XXXXXX";
+	char binary[sizeof(text) + 4];
+	struct code_seg_t * code;
+	uint32_t priority;
+	double t_text, t_binary;
+	int fd;
+
+	if ((fd = mkstemp(text)) < 0) {
+		printf("Cannot create a temporary file\n");
+		return 1;
+	}
+	close(fd);
+	snprintf(binary, sizeof(binary), "%s.bin", text);
+	write_text(text, n);
+	code = load_code(text, &priority);
+	save_program(binary, priority, code);
+	free_code(code);
+
+	t_text = measure(text);
+	t_binary = measure(binary);
+	printf("%d instructions: text %.3f ms, binary %.3f ms, %.1fx faster\n",
+		n, t_text * 1e3, t_binary * 1e3, t_text / t_binary);
+
+	unlink(text);
+	unlink(binary);
+	return 0;
+}
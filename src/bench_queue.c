@@ -0,0 +1,119 @@
+
+/*
+ * Dequeue cost of the priority queue against its length.
+ *
+ * A queue of n processes with random priorities is kept at steady state:
+ * every step takes the first process out and puts it back in, like a CPU
+ * putting back a preempted process and dispatching the next one. The
+ * heap in queue.c is measured against the scan-and-shift array it
+ * replaced, which is kept here verbatim.
+ *
+ * Usage: bench_queue [number of steps]
+ */
+
+#include "queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_STEPS 200000
+
+static const int lengths[] = {16, 256, 4096, 65536};
+
+/* ----- Legacy scan-and-shift queue ----- */
+
+struct legacy_queue_t {
+	struct pcb_t ** proc;
+	int size;
+};
+
+static void legacy_enqueue(struct legacy_queue_t * q, struct pcb_t * proc) {
+	q->proc[q->size] = proc;
+	q->size++;
+}
+
+static struct pcb_t * legacy_dequeue(struct legacy_queue_t * q) {
+	if (q == NULL || q->size == 0)
+		return 0;
+	int min_priority_index = 0;
+	for (int i = 1; i < q->size; i++){
+		if (q->proc[i]->priority < q->proc[min_priority_index]->priority){
+			min_priority_index = i;
+		}
+	}
+	struct pcb_t *proc = q->proc[min_priority_index];
+	for (int i = min_priority_index; i < q->size - 1; i++) {
+		q->proc[i] = q->proc[i + 1];
+	}
+	q->proc[q->size - 1] = NULL;
+	q->size--;
+	return proc;
+}
+
+/* ----- Workloads ----- */
+
+static double now_sec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Nanoseconds per dequeue + enqueue step */
+static double run(int legacy, struct pcb_t * procs, int n, long steps) {
+	struct legacy_queue_t lq;
+	struct pqueue_t pq = {0};
+	double start, end;
+	long i;
+
+	lq.proc = malloc(n * sizeof(struct pcb_t *));
+	lq.size = 0;
+	for (i = 0; i < n; i++) {
+		if (legacy) {
+			legacy_enqueue(&lq, &procs[i]);
+		} else {
+			pq_enqueue(&pq, &procs[i]);
+		}
+	}
+
+	start = now_sec();
+	for (i = 0; i < steps; i++) {
+		if (legacy) {
+			legacy_enqueue(&lq, legacy_dequeue(&lq));
+		} else {
+			pq_enqueue(&pq, pq_dequeue(&pq));
+		}
+	}
+	end = now_sec();
+
+	free(lq.proc);
+	pq_free(&pq);
+	return (end - start) * 1e9 / steps;
+}
+
+int main(int argc, char * argv[]) {
+	long steps = (argc > 1) ? atol(argv[1]) : DEFAULT_STEPS;
+	unsigned int i;
+	int j;
+
+	printf("%8s %14s %14s %8s\n", "length", "scan ns/op", "heap ns/op",
+		"speedup");
+	for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+		int n = lengths[i];
+		struct pcb_t * procs = calloc(n, sizeof(struct pcb_t));
+		/* Few distinct values, so ties are broken often */
+		srand(n);
+		for (j = 0; j < n; j++) {
+			procs[j].priority = rand() % 40;
+		}
+		/* The scan is quadratic, keep its run time bounded */
+		long scan_steps = (n > 4096) ? steps / 100 : steps;
+		double legacy = run(1, procs, n, scan_steps);
+		double heap = run(0, procs, n, steps);
+		printf("%8d %14.1f %14.1f %7.1fx\n", n, legacy, heap,
+			legacy / heap);
+		fflush(stdout);
+		free(procs);
+	}
+	return 0;
+}
+
@@ -0,0 +1,113 @@
+
+/*
+ * Contention benchmark of the scheduler run queues.
+ *
+ * N threads share one global run queue and do nothing but dispatch a
+ * process and put it back, like CPUs whose processes all run a single
+ * slot. The numbers are dispatches per second summed over the threads,
+ * for the locked MLQ policy and the lock-free one.
+ *
+ * The processes are spread over the 8 highest priority levels, then
+ * over the 8 lowest ones. The low levels have 1 to 8 time slots each,
+ * so the budgets are refilled every 36 dispatches instead of every 1092.
+ *
+ * Usage: bench_sched [dispatches per thread]
+ */
+
+#include "sched.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_OPS 200000
+#define NR_PROCS 256
+
+static const int thread_counts[] = {1, 2, 4, 8, 16};
+static const char * const policies[] = {"mlq", "mlq_lf"};
+
+static struct pcb_t procs[NR_PROCS];
+
+struct bench_args {
+	int id;
+	long ops;
+	long done;	// Dispatches that got a process
+};
+
+static void * hammer(void * args) {
+	struct bench_args * a = (struct bench_args *)args;
+	long i;
+	sched_set_cpu(a->id);
+	for (i = 0; i < a->ops; i++) {
+		struct pcb_t * proc = get_proc();
+		if (proc != NULL) {
+			put_proc(proc);
+			a->done++;
+		}
+	}
+	return NULL;
+}
+
+static double now_sec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double run(const char * policy, int first_prio, int nthreads,
+		long ops) {
+	pthread_t * thread = malloc(sizeof(pthread_t) * nthreads);
+	struct bench_args * args = calloc(nthreads, sizeof(struct bench_args));
+	double start, end;
+	long done = 0;
+	int i;
+
+	sched_set_policy(policy);
+	sched_set_capacity(NR_PROCS);
+	init_scheduler();
+	for (i = 0; i < NR_PROCS; i++) {
+		procs[i].pid = i + 1;
+		procs[i].prio = first_prio + i % 8;
+		procs[i].priority = procs[i].prio;
+		add_proc(&procs[i]);
+	}
+
+	start = now_sec();
+	for (i = 0; i < nthreads; i++) {
+		args[i].id = i;
+		args[i].ops = ops;
+		pthread_create(&thread[i], NULL, hammer, &args[i]);
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(thread[i], NULL);
+		done += args[i].done;
+	}
+	end = now_sec();
+
+	finish_scheduler();
+	free(thread);
+	free(args);
+	return done / (end - start);
+}
+
+int main(int argc, char * argv[]) {
+	long ops = (argc > 1) ? atol(argv[1]) : DEFAULT_OPS;
+	static const int first_prio[] = {0, MAX_PRIO - 8};
+	unsigned int i, j;
+
+	for (j = 0; j < 2; j++) {
+		printf("priorities %d-%d\n", first_prio[j], first_prio[j] + 7);
+		printf("%8s %16s %16s %8s\n",
+			"threads", "mlq disp/s", "mlq_lf disp/s", "speedup");
+		for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+			int n = thread_counts[i];
+			double locked = run(policies[0], first_prio[j], n, ops);
+			double lockfree = run(policies[1], first_prio[j], n, ops);
+			printf("%8d %16.0f %16.0f %7.2fx\n",
+				n, locked, lockfree, lockfree / locked);
+			fflush(stdout);
+		}
+	}
+	return 0;
+}
+
@@ -0,0 +1,214 @@
+
+/*
+ * Slots-per-second benchmark of the simulated clock.
+ *
+ * Every simulated CPU is a thread that does nothing but call next_slot(),
+ * so the numbers are the pure synchronization cost of one time slot. The
+ * barrier clock in timer.c is measured against the per-device
+ * mutex/condvar handshake it replaced, which is kept here verbatim.
+ *
+ * Usage: bench_timer [number of slots]
+ */
+
+#include "timer.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SLOTS 20000
+
+static const int cpu_counts[] = {1, 4, 16, 64};
+
+/* ----- Legacy handshake clock ----- */
+
+struct legacy_id_t {
+	int done;
+	int fsh;
+	pthread_cond_t event_cond;
+	pthread_mutex_t event_lock;
+	pthread_cond_t timer_cond;
+	pthread_mutex_t timer_lock;
+	struct legacy_id_t * next;
+};
+
+static struct legacy_id_t * legacy_list = NULL;
+static uint64_t legacy_time;
+static pthread_t legacy_timer;
+
+static void * legacy_routine(void * args) {
+	while (1) {
+		printf("Time slot %3lu\n", legacy_time);
+		int fsh = 0;
+		int event = 0;
+		struct legacy_id_t * temp;
+		for (temp = legacy_list; temp != NULL; temp = temp->next) {
+			pthread_mutex_lock(&temp->event_lock);
+			while (!temp->done && !temp->fsh) {
+				pthread_cond_wait(&temp->event_cond,
+					&temp->event_lock);
+			}
+			if (temp->fsh) {
+				fsh++;
+			}
+			event++;
+			pthread_mutex_unlock(&temp->event_lock);
+		}
+		legacy_time++;
+		for (temp = legacy_list; temp != NULL; temp = temp->next) {
+			pthread_mutex_lock(&temp->timer_lock);
+			temp->done = 0;
+			pthread_cond_signal(&temp->timer_cond);
+			pthread_mutex_unlock(&temp->timer_lock);
+		}
+		if (fsh == event) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+static void legacy_next_slot(struct legacy_id_t * id) {
+	pthread_mutex_lock(&id->event_lock);
+	id->done = 1;
+	pthread_cond_signal(&id->event_cond);
+	pthread_mutex_unlock(&id->event_lock);
+
+	pthread_mutex_lock(&id->timer_lock);
+	while (id->done) {
+		pthread_cond_wait(&id->timer_cond, &id->timer_lock);
+	}
+	pthread_mutex_unlock(&id->timer_lock);
+}
+
+static void legacy_detach(struct legacy_id_t * id) {
+	pthread_mutex_lock(&id->event_lock);
+	id->fsh = 1;
+	pthread_cond_signal(&id->event_cond);
+	pthread_mutex_unlock(&id->event_lock);
+}
+
+static struct legacy_id_t * legacy_attach(void) {
+	struct legacy_id_t * id = malloc(sizeof(struct legacy_id_t));
+	id->done = 0;
+	id->fsh = 0;
+	pthread_cond_init(&id->event_cond, NULL);
+	pthread_mutex_init(&id->event_lock, NULL);
+	pthread_cond_init(&id->timer_cond, NULL);
+	pthread_mutex_init(&id->timer_lock, NULL);
+	id->next = legacy_list;
+	legacy_list = id;
+	return id;
+}
+
+static void legacy_stop(void) {
+	pthread_join(legacy_timer, NULL);
+	while (legacy_list != NULL) {
+		struct legacy_id_t * temp = legacy_list;
+		legacy_list = legacy_list->next;
+		pthread_cond_destroy(&temp->event_cond);
+		pthread_mutex_destroy(&temp->event_lock);
+		pthread_cond_destroy(&temp->timer_cond);
+		pthread_mutex_destroy(&temp->timer_lock);
+		free(temp);
+	}
+	legacy_time = 0;
+}
+
+/* ----- Workers ----- */
+
+struct bench_args {
+	void * id;
+	long slots;
+};
+
+static void * barrier_cpu(void * args) {
+	struct bench_args * a = (struct bench_args *)args;
+	long i;
+	for (i = 0; i < a->slots; i++) {
+		next_slot((struct timer_id_t *)a->id);
+	}
+	detach_event((struct timer_id_t *)a->id);
+	return NULL;
+}
+
+static void * legacy_cpu(void * args) {
+	struct bench_args * a = (struct bench_args *)args;
+	long i;
+	for (i = 0; i < a->slots; i++) {
+		legacy_next_slot((struct legacy_id_t *)a->id);
+	}
+	legacy_detach((struct legacy_id_t *)a->id);
+	return NULL;
+}
+
+static double now_sec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double run(int legacy, int ncpus, long slots) {
+	pthread_t * cpu = malloc(sizeof(pthread_t) * ncpus);
+	struct bench_args * args = malloc(sizeof(struct bench_args) * ncpus);
+	double start, end;
+	int i;
+
+	for (i = 0; i < ncpus; i++) {
+		args[i].id = legacy ? (void *)legacy_attach() :
+				(void *)attach_event();
+		args[i].slots = slots;
+	}
+
+	start = now_sec();
+	if (legacy) {
+		pthread_create(&legacy_timer, NULL, legacy_routine, NULL);
+	} else {
+		start_timer();
+	}
+	for (i = 0; i < ncpus; i++) {
+		pthread_create(&cpu[i], NULL,
+			legacy ? legacy_cpu : barrier_cpu, &args[i]);
+	}
+	for (i = 0; i < ncpus; i++) {
+		pthread_join(cpu[i], NULL);
+	}
+	if (legacy) {
+		legacy_stop();
+	} else {
+		stop_timer();
+	}
+	end = now_sec();
+
+	free(cpu);
+	free(args);
+	return slots / (end - start);
+}
+
+int main(int argc, char * argv[]) {
+	long slots = (argc > 1) ? atol(argv[1]) : DEFAULT_SLOTS;
+	FILE * out;
+	unsigned int i;
+
+	/* Both clocks print every slot, keep that out of the report */
+	out = fdopen(dup(fileno(stdout)), "w");
+	if (out == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+		perror("bench_timer");
+		return 1;
+	}
+
+	fprintf(out, "%6s %16s %16s %8s\n",
+		"CPUs", "handshake sl/s", "barrier sl/s", "speedup");
+	for (i = 0; i < sizeof(cpu_counts) / sizeof(cpu_counts[0]); i++) {
+		int n = cpu_counts[i];
+		double legacy = run(1, n, slots);
+		double barrier = run(0, n, slots);
+		fprintf(out, "%6d %16.0f %16.0f %7.2fx\n",
+			n, legacy, barrier, barrier / legacy);
+		fflush(out);
+	}
+	fclose(out);
+	return 0;
+}
+
@@ -4,6 +4,7 @@
 #include "mm.h"
 #include "syscall.h"
 #include "libmem.h"
+#include <stdlib.h>
 
 int calc(struct pcb_t *proc)
 {
@@ -58,55 +59,283 @@ int write(
 	return write_mem(proc->regs[destination] + offset, proc, data);
 }
 
-int run(struct pcb_t *proc)
+/* readn source offset size: read [size] bytes from [source] + [offset],
+ * which only brings them in as the instruction has no destination */
+static int read_range(struct pcb_t *proc, uint32_t source, uint32_t offset,
+	uint32_t size)
 {
-	/* Check if Program Counter point to the proper instruction */
-	if (proc->pc >= proc->code->size)
+#ifdef MM_PAGING
+	return libread_range(proc, source, offset, NULL, size);
+#else
+	uint32_t i;
+	BYTE data;
+	for (i = 0; i < size; i++)
 	{
-		return 1;
+		if (read_mem(proc->regs[source] + offset + i, proc, &data))
+			return 1;
 	}
+	return 0;
+#endif
+}
+
+/* writen data destination offset size: write [data] to the [size] bytes
+ * from [destination] + [offset] on */
+static int write_range(struct pcb_t *proc, BYTE data, uint32_t destination,
+	uint32_t offset, uint32_t size)
+{
+#ifdef MM_PAGING
+	return libfill_range(proc, data, destination, offset, size);
+#else
+	uint32_t i;
+	for (i = 0; i < size; i++)
+	{
+		if (write_mem(proc->regs[destination] + offset + i, proc, data))
+			return 1;
+	}
+	return 0;
+#endif
+}
+
+/* Run [ins] of [proc] through the switch: READN, WRITEN and the
+ * instructions whose operands do not fit an op_t */
+static int run_inst(struct pcb_t *proc, const struct inst_t *ins)
+{
+	uint32_t dst;
 
-	struct inst_t ins = proc->code->text[proc->pc];
-	proc->pc++;
-	int stat = 1;
-switch (ins.opcode)
+	switch (ins->opcode)
 	{
 	case CALC:
-		stat = calc(proc);
-		break;
+		return calc(proc);
 	case ALLOC:
 #ifdef MM_PAGING
-		stat = liballoc(proc, ins.arg_0, ins.arg_1);
+		return liballoc(proc, ins->arg_0, ins->arg_1);
 #else
-		stat = alloc(proc, ins.arg_0, ins.arg_1);
+		return alloc(proc, ins->arg_0, ins->arg_1);
 #endif
-		break;
 	case FREE:
 #ifdef MM_PAGING
-		stat = libfree(proc, ins.arg_0);
+		return libfree(proc, ins->arg_0);
 #else
-		stat = free_data(proc, ins.arg_0);
+		return free_data(proc, ins->arg_0);
 #endif
-		break;
 	case READ:
 #ifdef MM_PAGING
-		stat = libread(proc, ins.arg_0, ins.arg_1, &ins.arg_2);
+		dst = ins->arg_2;
+		return libread(proc, ins->arg_0, ins->arg_1, &dst);
 #else
-		stat = read(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+		(void)dst;
+		return read(proc, ins->arg_0, ins->arg_1, ins->arg_2);
 #endif
-		break;
 	case WRITE:
 #ifdef MM_PAGING
-		stat = libwrite(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+		return libwrite(proc, ins->arg_0, ins->arg_1, ins->arg_2);
 #else
-		stat = write(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+		return write(proc, ins->arg_0, ins->arg_1, ins->arg_2);
 #endif
-		break;
 	case SYSCALL:
-		stat = libsyscall(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
-		break;
+		return libsyscall(proc, ins->arg_0, ins->arg_1, ins->arg_2, ins->arg_3);
+	case READN:
+		return read_range(proc, ins->arg_0, ins->arg_1, ins->arg_2);
+	case WRITEN:
+		return write_range(proc, ins->arg_0, ins->arg_1, ins->arg_2,
+			ins->arg_3);
 	default:
-		stat = 1;
+		return 1;
+	}
+}
+
+/* Handlers of run() by opcode, and the one going through run_inst() */
+static const void *const *handlers;
+#define OP_GENERIC (WRITEN + 1)
+
+void decode_code(struct code_seg_t *code)
+{
+	uint32_t i = code->size;
+	uint32_t calcs = 0;
+
+	if (handlers == NULL)
+	{
+		run(NULL);
+	}
+	code->ops = malloc(sizeof(struct op_t) * (code->size ? code->size : 1));
+	while (i-- > 0)
+	{
+		const struct inst_t *ins = &code->text[i];
+		struct op_t *op = &code->ops[i];
+		int h = OP_GENERIC;
+
+		op->arg = op->reg_0 = op->reg_1 = 0;
+		calcs = (ins->opcode == CALC) ? calcs + 1 : 0;
+		switch (ins->opcode)
+		{
+		case CALC:
+			h = CALC;
+			op->arg = calcs;
+			break;
+		case ALLOC:
+			if (ins->arg_1 <= UINT16_MAX)
+			{
+				h = ALLOC;
+				op->arg = ins->arg_0;
+				op->reg_0 = ins->arg_1;
+			}
+			break;
+		case FREE:
+			if (ins->arg_0 <= UINT16_MAX)
+			{
+				h = FREE;
+				op->reg_0 = ins->arg_0;
+			}
+			break;
+		case READ:
+			if (ins->arg_0 <= UINT16_MAX && ins->arg_2 <= UINT16_MAX)
+			{
+				h = READ;
+				op->reg_0 = ins->arg_0;
+				op->arg = ins->arg_1;
+				op->reg_1 = ins->arg_2;
+			}
+			break;
+		case WRITE:
+			/* Only the low byte of the data is ever written */
+			if (ins->arg_1 <= UINT16_MAX)
+			{
+				h = WRITE;
+				op->reg_1 = (BYTE)ins->arg_0;
+				op->reg_0 = ins->arg_1;
+				op->arg = ins->arg_2;
+			}
+			break;
+		case SYSCALL:
+			if (ins->arg_0 <= UINT16_MAX && ins->arg_2 <= UINT16_MAX &&
+				ins->arg_3 == 0)
+			{
+				h = SYSCALL;
+				op->reg_0 = ins->arg_0;
+				op->arg = ins->arg_1;
+				op->reg_1 = ins->arg_2;
+			}
+			break;
+		default:
+			break;
+		}
+		op->handler = handlers[h];
+	}
+}
+
+/* Threaded code interpreter. The loader decoded each instruction into
+ * an op_t holding the address of its handler below, so running one is
+ * a bound check and an indirect jump instead of copying the inst_t and
+ * going through the switch. Called with no process, it only publishes
+ * its handlers for decode_code(). */
+int run(struct pcb_t *proc)
+{
+	static const void *const labels[] = {
+		[CALC] = &&do_calc,
+		[ALLOC] = &&do_alloc,
+		[FREE] = &&do_free,
+		[READ] = &&do_read,
+		[WRITE] = &&do_write,
+		[SYSCALL] = &&do_syscall,
+		[READN] = &&do_generic,
+		[WRITEN] = &&do_generic,
+		[OP_GENERIC] = &&do_generic,
+	};
+	const struct op_t *op;
+	uint32_t dst;
+	int stat;
+
+	if (proc == NULL)
+	{
+		handlers = labels;
+		return 0;
+	}
+
+	/* Check if Program Counter point to the proper instruction */
+	if (proc->pc >= proc->code->size)
+	{
+		return 1;
+	}
+	if (proc->code->ops == NULL)
+	{
+		decode_code(proc->code);
+	}
+	op = &proc->code->ops[proc->pc++];
+	goto *op->handler;
+
+do_calc:
+	/* calc() only uses the CPU and always succeeds */
+	return 0;
+do_alloc:
+#ifdef MM_PAGING
+	stat = liballoc(proc, op->arg, op->reg_0);
+#else
+	stat = alloc(proc, op->arg, op->reg_0);
+#endif
+	goto out;
+do_free:
+#ifdef MM_PAGING
+	stat = libfree(proc, op->reg_0);
+#else
+	stat = free_data(proc, op->reg_0);
+#endif
+	goto out;
+do_read:
+#ifdef MM_PAGING
+	dst = op->reg_1;
+	stat = libread(proc, op->reg_0, op->arg, &dst);
+#else
+	(void)dst;
+	stat = read(proc, op->reg_0, op->arg, op->reg_1);
+#endif
+	goto out;
+do_write:
+#ifdef MM_PAGING
+	stat = libwrite(proc, op->reg_1, op->reg_0, op->arg);
+#else
+	stat = write(proc, op->reg_1, op->reg_0, op->arg);
+#endif
+	goto out;
+do_syscall:
+	stat = libsyscall(proc, op->reg_0, op->arg, op->reg_1, 0);
+	goto out;
+do_generic:
+	stat = run_inst(proc, &proc->code->text[proc->pc - 1]);
+out:
+	if (proc->state == PROC_BLOCKED)
+	{
+		/* Page fault left to the I/O worker, run the instruction
+		 * again once the page is in */
+		proc->pc--;
 	}
 	return stat;
 }
+
+int run_local(struct pcb_t *proc, int max)
+{
+	const struct op_t *op;
+	uint32_t n;
+
+	if (proc->pc >= proc->code->size)
+	{
+		return 0;
+	}
+	if (proc->code->ops == NULL)
+	{
+		decode_code(proc->code);
+	}
+	/* calc() does not touch the process, so a whole run of CALC
+	 * instructions is skipped at once */
+	op = &proc->code->ops[proc->pc];
+	if (op->handler != handlers[CALC])
+	{
+		return 0;
+	}
+	n = op->arg;
+	if (n > (uint32_t)max)
+	{
+		n = max;
+	}
+	proc->pc += n;
+	return n;
+}
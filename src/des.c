@@ -0,0 +1,329 @@
+#include "des.h"
+#include "timer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct des_actor {
+	des_step_t step;
+	void * arg;
+	uint64_t next;	// Slot of its next step
+	uint64_t ret;	// What its last step returned
+	int idle;	// Waiting for the other actors
+	des_recall_t recall;
+};
+
+static struct des_actor * actors = NULL;
+static int nr_actors = 0;
+static int max_actors = 0;
+
+/* Pending events, a binary min-heap of actor indexes ordered by the slot
+ * of their next step then by registration order */
+static int * events = NULL;
+static int nr_events = 0;
+
+/* Idle actors, by registration order */
+static int * idle = NULL;
+static int nr_idle = 0;
+
+/* Actors to step in the current slot, by registration order */
+static int * jobs = NULL;
+static int nr_jobs = 0;
+static _Atomic int next_job;
+
+/* An actor did something in the last slot, the idle ones must look
+ * again in the next one */
+static int poke;
+
+/* Worker pool, the engine thread is worker 0 */
+static pthread_barrier_t slot_start;
+static pthread_barrier_t slot_end;
+static int quit;
+
+static int event_before(int a, int b) {
+	if (actors[a].next != actors[b].next) {
+		return actors[a].next < actors[b].next;
+	}
+	return a < b;
+}
+
+static void push_event(int a) {
+	int i = nr_events++;
+	while (i > 0 && event_before(a, events[(i - 1) / 2])) {
+		events[i] = events[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	events[i] = a;
+}
+
+static int pop_event(void) {
+	int top = events[0];
+	int last = events[--nr_events];
+	int i = 0;
+	while (2 * i + 1 < nr_events) {
+		int child = 2 * i + 1;
+		if (child + 1 < nr_events &&
+				event_before(events[child + 1], events[child])) {
+			child++;
+		}
+		if (!event_before(events[child], last)) {
+			break;
+		}
+		events[i] = events[child];
+		i = child;
+	}
+	events[i] = last;
+	return top;
+}
+
+void des_add_actor(des_step_t step, void * arg) {
+	if (nr_actors == max_actors) {
+		max_actors = max_actors ? 2 * max_actors : 16;
+		actors = realloc(actors, max_actors * sizeof(struct des_actor));
+		events = realloc(events, max_actors * sizeof(int));
+		idle = realloc(idle, max_actors * sizeof(int));
+		jobs = realloc(jobs, 2 * max_actors * sizeof(int));
+	}
+	actors[nr_actors].step = step;
+	actors[nr_actors].arg = arg;
+	actors[nr_actors].next = current_time();
+	actors[nr_actors].idle = 0;
+	actors[nr_actors].recall = NULL;
+	push_event(nr_actors);
+	nr_actors++;
+}
+
+void des_set_recall(void * arg, des_recall_t recall) {
+	int i;
+	for (i = 0; i < nr_actors; i++) {
+		if (actors[i].arg == arg) {
+			actors[i].recall = recall;
+		}
+	}
+}
+
+/* Bring forward to [slot] the pending steps of the actors from [first]
+ * on that want to be back. Return whether there was any. */
+static int recall_actors(uint64_t slot, int first) {
+	int i, n = nr_events, moved = 0;
+
+	for (i = 0; i < n; i++) {
+		struct des_actor * a = &actors[events[i]];
+		if (events[i] >= first && a->recall != NULL && a->next > slot &&
+				a->recall(a->arg, slot)) {
+			a->next = slot;
+			moved = 1;
+		}
+	}
+	if (moved) {
+		/* Push them all again, each one is read before its cell is
+		 * reused */
+		nr_events = 0;
+		for (i = 0; i < n; i++) {
+			push_event(events[i]);
+		}
+	}
+	return moved;
+}
+
+/* Actors after jobs[j] recalled into slot [now] step later in this slot,
+ * as if they had not asked for a later one */
+static void recall_jobs(uint64_t now, int j) {
+	int k;
+
+	if (!recall_actors(now, jobs[j] + 1)) {
+		return;
+	}
+	while (nr_events > 0 && actors[events[0]].next == now) {
+		int a = pop_event();
+		for (k = nr_jobs++; k > j + 1 && jobs[k - 1] > a; k--) {
+			jobs[k] = jobs[k - 1];
+		}
+		jobs[k] = a;
+	}
+}
+
+static void run_jobs(void) {
+	int j;
+	while ((j = atomic_fetch_add(&next_job, 1)) < nr_jobs) {
+		struct des_actor * a = &actors[jobs[j]];
+		a->ret = a->step(a->arg);
+	}
+}
+
+static void * des_worker(void * arg) {
+	while (1) {
+		pthread_barrier_wait(&slot_start);
+		if (quit) {
+			break;
+		}
+		run_jobs();
+		pthread_barrier_wait(&slot_end);
+	}
+	return NULL;
+}
+
+/* Collect the actors to step in slot [now], the idle ones only if
+ * somebody acted in the slot before */
+static void collect_jobs(uint64_t now) {
+	int * due = jobs + max_actors;
+	int nr_due = 0;
+	int i = 0, k = 0;
+
+	while (nr_events > 0 && actors[events[0]].next == now) {
+		due[nr_due++] = pop_event();
+	}
+	if (!poke) {
+		for (i = 0; i < nr_due; i++) {
+			jobs[i] = due[i];
+		}
+		nr_jobs = nr_due;
+		return;
+	}
+
+	nr_jobs = 0;
+	while (i < nr_due || k < nr_idle) {
+		if (k == nr_idle || (i < nr_due && due[i] < idle[k])) {
+			jobs[nr_jobs++] = due[i++];
+		}else{
+			jobs[nr_jobs++] = idle[k++];
+		}
+	}
+}
+
+static void run_slot(int nworkers) {
+	int quiet = 0;
+	int j;
+
+	atomic_store(&next_job, 0);
+	if (nworkers > 1) {
+		/* Everybody runs at once, an idle actor cannot know whether
+		 * the ones before it did anything */
+		pthread_barrier_wait(&slot_start);
+		run_jobs();
+		pthread_barrier_wait(&slot_end);
+		poke = 0;
+		for (j = 0; j < nr_jobs; j++) {
+			struct des_actor * a = &actors[jobs[j]];
+			if (!a->idle || a->ret != DES_IDLE) {
+				poke = 1;
+			}
+		}
+		return;
+	}
+
+	/* Once an idle actor finds nothing to do, the idle ones right after
+	 * it will not either since nothing changed in between */
+	poke = 0;
+	for (j = 0; j < nr_jobs; j++) {
+		struct des_actor * a = &actors[jobs[j]];
+		if (a->idle && quiet) {
+			continue;
+		}
+		a->ret = a->step(a->arg);
+		if (a->idle && a->ret == DES_IDLE) {
+			quiet = 1;
+		}else{
+			quiet = 0;
+			poke = 1;
+			recall_jobs(current_time(), j);
+		}
+	}
+}
+
+/* Queue the next step of every actor that ran in slot [now] and rebuild
+ * the idle list */
+static void settle_slot(uint64_t now) {
+	int * merged = jobs + max_actors;
+	int nr_merged = 0;
+	int i = 0, k = 0;
+
+	for (i = 0; i < nr_jobs; i++) {
+		struct des_actor * a = &actors[jobs[i]];
+		a->idle = (a->ret == DES_IDLE);
+		if (a->ret != DES_STOP && a->ret != DES_IDLE) {
+			a->next = now + a->ret;
+			push_event(jobs[i]);
+		}
+	}
+
+	/* Both lists are sorted, the polled idle actors are in both */
+	i = 0;
+	while (i < nr_jobs || k < nr_idle) {
+		int a;
+		if (i == nr_jobs || (k < nr_idle && idle[k] < jobs[i])) {
+			a = idle[k++];
+		}else{
+			if (k < nr_idle && idle[k] == jobs[i]) {
+				k++;
+			}
+			a = jobs[i++];
+		}
+		if (actors[a].idle) {
+			merged[nr_merged++] = a;
+		}
+	}
+	for (i = 0; i < nr_merged; i++) {
+		idle[i] = merged[i];
+	}
+	nr_idle = nr_merged;
+}
+
+void des_run(int nworkers) {
+	pthread_t * workers = NULL;
+	uint64_t now = current_time();
+	int i;
+
+	if (nworkers > 1) {
+		quit = 0;
+		pthread_barrier_init(&slot_start, NULL, nworkers);
+		pthread_barrier_init(&slot_end, NULL, nworkers);
+		workers = malloc((nworkers - 1) * sizeof(pthread_t));
+		for (i = 0; i < nworkers - 1; i++) {
+			pthread_create(&workers[i], NULL, des_worker, NULL);
+		}
+	}
+
+	/* Idle actors are left alone once no event is pending and nobody
+	 * acted, there is nothing that could wake them up */
+	printf("Time slot %3lu\n", now);
+	poke = 0;
+	while (nr_events > 0 || (poke && nr_idle > 0)) {
+		uint64_t next = (poke && nr_idle > 0) ? now + 1 : DES_IDLE;
+		if (nr_events > 0 && actors[events[0]].next < next) {
+			next = actors[events[0]].next;
+		}
+		/* Slots without any event are only printed */
+		while (now < next) {
+			now++;
+			printf("Time slot %3lu\n", now);
+		}
+		set_current_time(now);
+		collect_jobs(now);
+		run_slot(nworkers);
+		settle_slot(now);
+		if (poke) {
+			recall_actors(now + 1, 0);
+		}
+	}
+
+	if (nworkers > 1) {
+		quit = 1;
+		pthread_barrier_wait(&slot_start);
+		for (i = 0; i < nworkers - 1; i++) {
+			pthread_join(workers[i], NULL);
+		}
+		pthread_barrier_destroy(&slot_start);
+		pthread_barrier_destroy(&slot_end);
+		free(workers);
+	}
+
+	free(actors);
+	free(events);
+	free(idle);
+	free(jobs);
+	actors = NULL;
+	events = idle = jobs = NULL;
+	nr_actors = max_actors = nr_events = nr_idle = nr_jobs = 0;
+}
@@ -18,6 +18,9 @@
 #include "mm.h"
 #include "syscall.h"
 #include "libmem.h"
+#include "pgio.h"
+#include "tlb.h"
+#include "sched.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
@@ -36,8 +39,7 @@ int enlist_vm_freerg_list(struct mm_struct *mm, struct vm_rg_struct *rg_elmt)
   if (rg_elmt->rg_start >= rg_elmt->rg_end)
     return -1;
 
-  if (rg_node != NULL)
-    rg_elmt->rg_next = rg_node;
+  rg_elmt->rg_next = rg_node;
 
   /* Enlist the new region */
   mm->mmap->vm_freerg_list = rg_elmt;
@@ -217,48 +219,79 @@ int liballoc(struct pcb_t *proc, uint32_t size, uint32_t reg_index)
    return result;
  }
 
-/*pg_getpage - get the page in ram
+/*pg_swapin - bring a page from MEMSWP to MEMRAM in place of a victim
  *@mm: memory region
  *@pagenum: PGN
- *@framenum: return FPN
  *@caller: caller
  *
  */
-int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
+int pg_swapin(struct mm_struct *mm, int pgn, struct pcb_t *caller)
 {
   uint32_t pte = mm->pgd[pgn];
+  int vicpgn, swpfpn, vicfpn;
+  uint32_t vicpte;
 
-  if (!PAGING_PAGE_PRESENT(pte))
-  { /* Page is not online, make it actively living */
-    int vicpgn, swpfpn, vicfpn;
-    uint32_t vicpte;
+  /* Find victim page */
+  if (find_victim_page(caller->mm, &vicpgn) != 0)
+    return -1; // None of our pages is in MEMRAM
 
-    /* Find victim page */
-    find_victim_page(caller->mm, &vicpgn);
+  /* Get the victim frame number */
+  vicpte = mm->pgd[vicpgn];
+  vicfpn = PAGING_PTE_FPN(vicpte);
 
-    /* Get the victim frame number */
-    vicpte = mm->pgd[vicpgn];
-    vicfpn = PAGING_PTE_FPN(vicpte);
+  /* Get free frame in MEMSWP */
+  if (MEMPHY_get_freefp(caller->active_mswp, &swpfpn) != 0)
+    return -1; // No free frame in swap space
 
-    /* Get free frame in MEMSWP */
-    if (MEMPHY_get_freefp(caller->active_mswp, &swpfpn) != 0)
-      return -1; // No free frame in swap space
+  /* Swap victim frame to MEMSWP */
+  __swap_cp_page(caller->mram, vicfpn, caller->active_mswp, swpfpn);
 
-    /* Swap victim frame to MEMSWP */
-    __swap_cp_page(caller->mram, vicfpn, caller->active_mswp, swpfpn);
+  /* Update victim page table entry to mark it as swapped */
+  pte_set_swap(&mm->pgd[vicpgn], 0, swpfpn);
+  tlb_shootdown(caller->pid, vicpgn);
 
-    /* Update victim page table entry to mark it as swapped */
-    pte_set_swap(&mm->pgd[vicpgn], 0, swpfpn);
+  /* Bring the target page from MEMSWP to MEMRAM, its swap frame is free
+   * again */
+  int tgtfpn = PAGING_PTE_SWP(pte);
+  __swap_cp_page(caller->active_mswp, tgtfpn, caller->mram, vicfpn);
+  if (PAGING_PAGE_SWAPPED(pte))
+    MEMPHY_put_freefp(caller->active_mswp, tgtfpn);
 
-    /* Bring the target page from MEMSWP to MEMRAM */
-    int tgtfpn = PAGING_PTE_SWP(pte);
-    __swap_cp_page(caller->active_mswp, tgtfpn, caller->mram, vicfpn);
+  /* Update target page table entry to mark it as present */
+  pte_set_fpn(&mm->pgd[pgn], vicfpn);
 
-    /* Update target page table entry to mark it as present */
-    pte_set_fpn(&mm->pgd[pgn], vicfpn);
+  /* Enlist the target page in the FIFO page list */
+  enlist_pgn_node(&caller->mm->fifo_pgn, pgn);
+
+  return 0;
+}
+
+/*pg_getpage - get the page in ram
+ *@mm: memory region
+ *@pagenum: PGN
+ *@framenum: return FPN
+ *@caller: caller
+ *
+ */
+int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
+{
+  uint32_t pte = mm->pgd[pgn];
 
-    /* Enlist the target page in the FIFO page list */
-    enlist_pgn_node(&caller->mm->fifo_pgn, pgn);
+  if (!PAGING_PAGE_PRESENT(pte) || PAGING_PAGE_SWAPPED(pte))
+  { /* Page is not online, make it actively living */
+    if (caller->fault_failed)
+    { /* The I/O worker could not bring it in */
+      caller->fault_failed = 0;
+      return -1;
+    }
+    if (pgio_async() && sched_block(caller) == 0)
+    { /* The I/O worker brings it in while the CPU runs another process,
+       * the instruction is run again once it is done */
+      caller->fault_pgn = pgn;
+      return -1;
+    }
+    if (pg_swapin(mm, pgn, caller) != 0)
+      return -1;
   }
 
   *fpn = PAGING_FPN(mm->pgd[pgn]);
@@ -266,6 +299,25 @@ int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
   return 0;
 }
 
+/*pg_translate - get the frame of a page, through the TLB of the CPU
+ *@mm: memory region
+ *@pagenum: PGN
+ *@framenum: return FPN
+ *@caller: caller
+ *
+ */
+static int pg_translate(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
+{
+  if (tlb_lookup(caller->pid, pgn, fpn) == 0)
+    return 0;
+
+  if (pg_getpage(mm, pgn, fpn, caller) != 0)
+    return -1;
+  tlb_insert(caller->pid, pgn, *fpn);
+
+  return 0;
+}
+
 /*pg_getval - read value at given offset
  *@mm: memory region
  *@addr: virtual address to acess
@@ -279,7 +331,7 @@ int pg_getval(struct mm_struct *mm, int addr, BYTE *data, struct pcb_t *caller)
   int fpn;
 
   /* Get the page to MEMRAM, swap from MEMSWAP if needed */
-  if (pg_getpage(mm, pgn, &fpn, caller) != 0)
+  if (pg_translate(mm, pgn, &fpn, caller) != 0)
     return -1; /* Invalid page access */
 
   /* Calculate the physical address */
@@ -305,7 +357,7 @@ int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
   int fpn;
 
   /* Get the page to MEMRAM, swap from MEMSWAP if needed */
-  if (pg_getpage(mm, pgn, &fpn, caller) != 0)
+  if (pg_translate(mm, pgn, &fpn, caller) != 0)
     return -1; /* Invalid page access */
 
   /* Calculate the physical address */
@@ -318,6 +370,56 @@ int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
   return 0; // Success
 }
 
+/* What pg_copy() does with the bytes of each page */
+enum pg_copy_op { PG_READ, PG_WRITE, PG_FILL };
+
+/*pg_copy - copy a span of memory from or to buf, translating each
+ *page once and moving the bytes it holds in one go
+ *@mm: memory region
+ *@addr: virtual address of the first byte
+ *@buf: destination of PG_READ, NULL to only bring the pages in, source
+ *      of PG_WRITE, or the byte PG_FILL writes all over the span
+ *@size: number of bytes
+ *@op: PG_READ, PG_WRITE or PG_FILL
+ *
+ */
+static int pg_copy(struct mm_struct *mm, int addr, BYTE *buf, int size,
+                   enum pg_copy_op op, struct pcb_t *caller)
+{
+  if (size < 0)
+    return -1;
+
+  while (size > 0)
+  {
+    int pgn = PAGING_PGN(addr);
+    int off = PAGING_OFFST(addr);
+    int len = PAGING_PAGESZ - off;
+    int fpn, phyaddr, ret = 0;
+
+    if (len > size)
+      len = size;
+    if (pg_translate(mm, pgn, &fpn, caller) != 0)
+      return -1; /* Invalid page access */
+
+    phyaddr = (fpn << NBITS(PAGING_PAGESZ)) | off;
+    if (op == PG_FILL)
+      ret = MEMPHY_fill_range(caller->mram, phyaddr, *buf, len);
+    else if (op == PG_WRITE)
+      ret = MEMPHY_write_range(caller->mram, phyaddr, buf, len);
+    else if (buf != NULL)
+      ret = MEMPHY_read_range(caller->mram, phyaddr, buf, len);
+    if (ret != 0)
+      return -1;
+
+    addr += len;
+    if (buf != NULL && op != PG_FILL)
+      buf += len;
+    size -= len;
+  }
+
+  return 0;
+}
+
 /*__read - read value in region memory
  *@caller: caller
  *@vmaid: ID vm area to alloc memory region
@@ -364,6 +466,88 @@ int libread(
   return val;
 }
 
+/*__rw_range - copy bytes between buf and a region memory
+ *@caller: caller
+ *@vmaid: ID vm area to alloc memory region
+ *@rgid: memory region ID (used to identify variable in symbole table)
+ *@offset: offset of the first byte in memory region
+ *@size: number of bytes
+ *
+ */
+static int __rw_range(struct pcb_t *caller, int vmaid, int rgid, int offset,
+                      BYTE *buf, int size, enum pg_copy_op op)
+{
+  struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
+  struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
+
+  if (currg == NULL || cur_vma == NULL) /* Invalid memory identify */
+    return -1;
+
+  return pg_copy(caller->mm, currg->rg_start + offset, buf, size, op, caller);
+}
+
+/*libread_range - PAGING-based read of size bytes of a region memory */
+int libread_range(
+    struct pcb_t *proc, // Process executing the instruction
+    uint32_t source,    // Index of source register
+    uint32_t offset,    // Source address = [source] + [offset]
+    BYTE *buf,          // Receives the bytes
+    uint32_t size)
+{
+  int val = __rw_range(proc, 0, source, offset, buf, size, PG_READ);
+
+#ifdef IODUMP
+  printf("read region=%d offset=%d size=%d\n", source, offset, size);
+#ifdef PAGETBL_DUMP
+  print_pgtbl(proc, 0, -1); //print max TBL
+#endif
+  MEMPHY_dump(proc->mram);
+#endif
+
+  return val;
+}
+
+/*libwrite_range - PAGING-based write of size bytes to a region memory */
+int libwrite_range(
+    struct pcb_t *proc,   // Process executing the instruction
+    const BYTE *buf,      // Data to be written into memory
+    uint32_t destination, // Index of destination register
+    uint32_t offset,
+    uint32_t size)
+{
+#ifdef IODUMP
+  printf("write region=%d offset=%d size=%d\n", destination, offset, size);
+#ifdef PAGETBL_DUMP
+  print_pgtbl(proc, 0, -1); //print max TBL
+#endif
+  MEMPHY_dump(proc->mram);
+#endif
+
+  return __rw_range(proc, 0, destination, offset, (BYTE *)buf, size,
+                    PG_WRITE);
+}
+
+/*libfill_range - PAGING-based write of value to size bytes of a region
+ *memory */
+int libfill_range(
+    struct pcb_t *proc,   // Process executing the instruction
+    BYTE value,           // Data to be written into memory
+    uint32_t destination, // Index of destination register
+    uint32_t offset,
+    uint32_t size)
+{
+#ifdef IODUMP
+  printf("fill region=%d offset=%d size=%d value=%d\n", destination, offset,
+         size, value);
+#ifdef PAGETBL_DUMP
+  print_pgtbl(proc, 0, -1); //print max TBL
+#endif
+  MEMPHY_dump(proc->mram);
+#endif
+
+  return __rw_range(proc, 0, destination, offset, &value, size, PG_FILL);
+}
+
 /*__write - write a region memory
  *@caller: caller
  *@vmaid: ID vm area to alloc memory region
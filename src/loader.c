@@ -1,17 +1,65 @@
 
 #include "loader.h"
+#include "cpu.h"
+#include "list.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
 
 static uint32_t avail_pid = 1;
 
+/* Programs already parsed, by path. A process shares the code of the
+ * entry of its file as long as the file did not change, the code is
+ * never written once decoded. The entries are chained in buckets by a
+ * hash of the path. */
+#define CODE_CACHE_BUCKETS 1024	// A power of two
+
+struct code_entry {
+	struct list_head node;
+	char * path;
+	struct timespec mtime;
+	off_t fsize;
+	struct code_seg_t * code;	// NULL while it is being parsed
+	uint32_t priority;
+	int used;		// A process took it already
+	long parse_ns;		// Host time the parse took
+	unsigned long bytes;	// Host memory of the code
+};
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cache_cond = PTHREAD_COND_INITIALIZER;
+static struct list_head code_cache[CODE_CACHE_BUCKETS];	// Zeroed until used
+static unsigned long nr_loads;
+static unsigned long nr_programs;
+static unsigned long parse_saved_ns;
+static unsigned long bytes_saved;
+static unsigned long nr_waits;		// Loads that waited for a parse
+
+/* Parse stage, see loader_prefetch() */
+static struct {
+	char ** paths;
+	int n;
+	_Atomic int next;
+	_Atomic int running;
+} prefetch;
+
+_Static_assert(sizeof(struct inst_t) == 5 * sizeof(uint32_t),
+	"binary programs hold packed inst_t records");
+
 #define OPT_CALC	"calc"
 #define OPT_ALLOC	"alloc"
 #define OPT_FREE	"free"
 #define OPT_READ	"read"
 #define OPT_WRITE	"write"
 #define OPT_SYSCALL	"syscall"
+#define OPT_READN	"readn"
+#define OPT_WRITEN	"writen"
 
 static enum ins_opcode_t get_opcode(char * opt) {
 	if (!strcmp(opt, OPT_CALC)) {
@@ -26,71 +74,78 @@ static enum ins_opcode_t get_opcode(char * opt) {
 		return WRITE;
 	}else if (!strcmp(opt, OPT_SYSCALL)) {
 		return SYSCALL;
+	}else if (!strcmp(opt, OPT_READN)) {
+		return READN;
+	}else if (!strcmp(opt, OPT_WRITEN)) {
+		return WRITEN;
 	}else{
 		printf("get_opcode return Opcode: %s\n", opt);
 		exit(1);
 	}
 }
 
-struct pcb_t * load(const char * path) {
-	/* Create new PCB for the new process */
-	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
-	proc->pid = avail_pid;
-	avail_pid++;
-	proc->page_table =
-		(struct page_table_t*)malloc(sizeof(struct page_table_t));
-	proc->bp = PAGE_SIZE;
-	proc->pc = 0;
-
+/* Parse the text program at [path] */
+static struct code_seg_t * parse_text(const char * path, uint32_t * priority) {
 	/* Read process code from file */
 	FILE * file;
 	if ((file = fopen(path, "r")) == NULL) {
 		printf("Cannot find process description at '%s'\n", path);
 		exit(1);		
 	}
-	snprintf(proc->path, 2*sizeof(path)+1, "%s", path);
 	char opcode[10];
-	proc->code = (struct code_seg_t*)malloc(sizeof(struct code_seg_t));
-	fscanf(file, "%u %u", &proc->priority, &proc->code->size);
-	proc->code->text = (struct inst_t*)malloc(
-		sizeof(struct inst_t) * proc->code->size
+	struct code_seg_t * code = (struct code_seg_t*)calloc(1,
+		sizeof(struct code_seg_t));
+	fscanf(file, "%u %u", priority, &code->size);
+	code->text = (struct inst_t*)malloc(
+		sizeof(struct inst_t) * code->size
 	);
 	uint32_t i = 0;
 	char buf[200];
-	for (i = 0; i < proc->code->size; i++) {
+	for (i = 0; i < code->size; i++) {
 		fscanf(file, "%s", opcode);
-		proc->code->text[i].opcode = get_opcode(opcode);
-		switch(proc->code->text[i].opcode) {
+		code->text[i].opcode = get_opcode(opcode);
+		switch(code->text[i].opcode) {
 		case CALC:
 			break;
 		case ALLOC:
 			fscanf(
 				file,
 				"%u %u\n",
-				&proc->code->text[i].arg_0,
-				&proc->code->text[i].arg_1
+				&code->text[i].arg_0,
+				&code->text[i].arg_1
 			);
 			break;
 		case FREE:
-			fscanf(file, "%u\n", &proc->code->text[i].arg_0);
+			fscanf(file, "%u\n", &code->text[i].arg_0);
 			break;
 		case READ:
 		case WRITE:
+		case READN:
 			fscanf(
 				file,
 				"%u %u %u\n",
-				&proc->code->text[i].arg_0,
-				&proc->code->text[i].arg_1,
-				&proc->code->text[i].arg_2
+				&code->text[i].arg_0,
+				&code->text[i].arg_1,
+				&code->text[i].arg_2
 			);
 			break;	
+		case WRITEN:
+			fscanf(
+				file,
+				"%u %u %u %u\n",
+				&code->text[i].arg_0,
+				&code->text[i].arg_1,
+				&code->text[i].arg_2,
+				&code->text[i].arg_3
+			);
+			break;
 		case SYSCALL:
 			fgets(buf, sizeof(buf), file);
 			sscanf(buf, "%d%d%d%d",
-			           &proc->code->text[i].arg_0,
-			           &proc->code->text[i].arg_1,
-			           &proc->code->text[i].arg_2,
-			           &proc->code->text[i].arg_3
+			           &code->text[i].arg_0,
+			           &code->text[i].arg_1,
+			           &code->text[i].arg_2,
+			           &code->text[i].arg_3
 			);
 			break;
 		default:
@@ -98,8 +153,266 @@ struct pcb_t * load(const char * path) {
 			exit(1);
 		}
 	}
+	fclose(file);
+	return code;
+}
+
+/* Map the binary program at [path], NULL if it is not one */
+static struct code_seg_t * map_binary(const char * path, uint32_t * priority) {
+	struct prog_header * hdr;
+	struct code_seg_t * code;
+	struct stat st;
+	void * map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(*hdr)) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+	hdr = map;
+	if (memcmp(hdr->magic, PROG_MAGIC, sizeof(hdr->magic)) != 0) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	if (hdr->version != PROG_VERSION || (st.st_size - sizeof(*hdr)) /
+			sizeof(struct inst_t) < hdr->size) {
+		printf("Bad binary program at '%s'\n", path);
+		exit(1);
+	}
+	code = (struct code_seg_t*)calloc(1, sizeof(struct code_seg_t));
+	code->text = (struct inst_t*)(hdr + 1);
+	code->size = hdr->size;
+	code->mapped = st.st_size;
+	*priority = hdr->priority;
+	return code;
+}
+
+struct code_seg_t * load_code(const char * path, uint32_t * priority) {
+	struct code_seg_t * code = map_binary(path, priority);
+	if (code == NULL) {
+		code = parse_text(path, priority);
+	}
+	decode_code(code);
+	return code;
+}
+
+void free_code(struct code_seg_t * code) {
+	if (code->mapped) {
+		munmap((struct prog_header*)code->text - 1, code->mapped);
+	}else{
+		free(code->text);
+	}
+	free(code->ops);
+	free(code);
+}
+
+int save_program(const char * path, uint32_t priority,
+		const struct code_seg_t * code) {
+	struct prog_header hdr;
+	FILE * file;
+	int ok;
+
+	if ((file = fopen(path, "wb")) == NULL) {
+		return -1;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PROG_MAGIC, sizeof(hdr.magic));
+	hdr.version = PROG_VERSION;
+	hdr.priority = priority;
+	hdr.size = code->size;
+	ok = fwrite(&hdr, sizeof(hdr), 1, file) == 1 &&
+		fwrite(code->text, sizeof(struct inst_t), code->size,
+			file) == code->size;
+	return (fclose(file) == 0 && ok) ? 0 : -1;
+}
+
+/* Bucket of [path] in the code cache, FNV-1a. Called with cache_lock
+ * held. */
+static struct list_head * code_bucket(const char * path) {
+	struct list_head * b;
+	uint32_t h = 2166136261u;
+
+	for (; *path != '\0'; path++) {
+		h = (h ^ (unsigned char)*path) * 16777619u;
+	}
+	b = &code_cache[h & (CODE_CACHE_BUCKETS - 1)];
+	if (b->next == NULL) {
+		INIT_LIST_HEAD(b);
+	}
+	return b;
+}
+
+/* Code of the program at [path], parsed unless the cache has it. A
+ * process takes a reference on it when [ref] is set, the parse stage
+ * only fills the cache. */
+static struct code_seg_t * code_get(const char * path, uint32_t * priority,
+		int ref) {
+	struct code_entry * e, * next;
+	struct code_seg_t * code;
+	struct list_head * bucket;
+	struct stat st;
+	struct timespec start, end;
+	int found = (stat(path, &st) == 0);
+	int waited = 0;
+
+	pthread_mutex_lock(&cache_lock);
+	if (ref) {
+		nr_loads++;
+	}
+	bucket = code_bucket(path);
+again:
+	list_for_each_entry_safe(e, next, bucket, node) {
+		if (strcmp(e->path, path) != 0) {
+			continue;
+		}
+		if (found && e->mtime.tv_sec == st.st_mtim.tv_sec &&
+				e->mtime.tv_nsec == st.st_mtim.tv_nsec &&
+				e->fsize == st.st_size) {
+			if (e->code == NULL) {
+				/* Another thread is parsing it */
+				if (ref && !waited) {
+					nr_waits++;
+					waited = 1;
+				}
+				pthread_cond_wait(&cache_cond, &cache_lock);
+				goto again;
+			}
+			if (ref) {
+				e->code->refs++;
+				if (e->used) {
+					parse_saved_ns += e->parse_ns;
+					bytes_saved += e->bytes;
+				}
+				e->used = 1;
+			}
+			*priority = e->priority;
+			pthread_mutex_unlock(&cache_lock);
+			return e->code;
+		}
+		if (e->code == NULL) {
+			continue;
+		}
+		/* The file changed, the processes still running the old
+		 * code keep it until they are gone */
+		list_del_init(&e->node);
+		e->code->cached = 0;
+		if (e->code->refs == 0) {
+			free_code(e->code);
+		}
+		free(e);
+	}
+	e = NULL;
+	if (found) {
+		/* Make the other threads wait for this parse */
+		e = calloc(1, sizeof(struct code_entry));
+		e->path = strdup(path);
+		e->mtime = st.st_mtim;
+		e->fsize = st.st_size;
+		list_add_tail(&e->node, bucket);
+		nr_programs++;
+	}
+	pthread_mutex_unlock(&cache_lock);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	code = load_code(path, priority);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	code->refs = ref;
+	if (e == NULL) {
+		return code;
+	}
+
+	pthread_mutex_lock(&cache_lock);
+	e->priority = *priority;
+	e->parse_ns = (end.tv_sec - start.tv_sec) * 1000000000L +
+		(end.tv_nsec - start.tv_nsec);
+	e->bytes = sizeof(struct code_seg_t) + code->size *
+		(sizeof(struct inst_t) + sizeof(uint32_t));
+	e->used = ref;
+	code->cached = 1;
+	e->code = code;
+	pthread_cond_broadcast(&cache_cond);
+	pthread_mutex_unlock(&cache_lock);
+	return code;
+}
+
+static void code_put(struct code_seg_t * code) {
+	pthread_mutex_lock(&cache_lock);
+	if (--code->refs == 0 && !code->cached) {
+		free_code(code);
+	}
+	pthread_mutex_unlock(&cache_lock);
+}
+
+struct pcb_t * load(const char * path) {
+	/* Create new PCB for the new process */
+	struct pcb_t * proc = (struct pcb_t * )calloc(1, sizeof(struct pcb_t));
+	proc->pid = avail_pid;
+	avail_pid++;
+	proc->page_table =
+		(struct page_table_t*)malloc(sizeof(struct page_table_t));
+	proc->bp = PAGE_SIZE;
+	proc->pc = 0;
+
+	proc->path = strdup(path);
+	proc->code = code_get(path, &proc->priority, 1);
 	return proc;
 }
 
+void unload(struct pcb_t * proc) {
+	code_put(proc->code);
+	free(proc->page_table);
+	free(proc->path);
+	free(proc);
+}
 
+static void * prefetch_routine(void * args) {
+	uint32_t priority;
+	int i;
 
+	while ((i = atomic_fetch_add(&prefetch.next, 1)) < prefetch.n) {
+		code_get(prefetch.paths[i], &priority, 0);
+		free(prefetch.paths[i]);
+	}
+	if (atomic_fetch_sub(&prefetch.running, 1) == 1) {
+		free(prefetch.paths);
+	}
+	return NULL;
+}
+
+void loader_prefetch(char * const * paths, int n, int nthreads) {
+	pthread_t thread;
+	int i;
+
+	if (n <= 0 || nthreads <= 0) {
+		return;
+	}
+	/* The admission stage frees its paths as it goes, work on copies */
+	prefetch.paths = malloc(n * sizeof(char *));
+	for (i = 0; i < n; i++) {
+		prefetch.paths[i] = strdup(paths[i]);
+	}
+	prefetch.n = n;
+	atomic_store(&prefetch.next, 0);
+	atomic_store(&prefetch.running, nthreads);
+	for (i = 0; i < nthreads; i++) {
+		pthread_create(&thread, NULL, prefetch_routine, NULL);
+		pthread_detach(thread);
+	}
+}
+
+void loader_stats(void) {
+	if (nr_loads == 0) {
+		return;
+	}
+	printf("Loader: %lu processes from %lu programs, %.3f ms of parsing and %lu KB saved, %lu waited for their parse\n",
+		nr_loads, nr_programs, parse_saved_ns / 1e6,
+		bytes_saved / 1024, nr_waits);
+}
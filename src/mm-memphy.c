@@ -8,6 +8,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+
+/* Guards the free frame lists of the devices, which the CPUs and the
+ * page fault I/O worker take frames from at the same time */
+static pthread_mutex_t fp_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /*
  *  MEMPHY_mv_csr - move MEMPHY cursor
@@ -108,6 +113,78 @@ int MEMPHY_write(struct memphy_struct *mp, int addr, BYTE data)
    return 0;
 }
 
+/*
+ *  MEMPHY_read_range - read [size] bytes from [addr] on
+ *  @mp: memphy struct
+ *  @addr: address
+ *  @buf: obtained values
+ *  @size: number of bytes
+ */
+int MEMPHY_read_range(struct memphy_struct *mp, int addr, BYTE *buf, int size)
+{
+   int i;
+
+   if (mp == NULL || addr < 0 || addr + size > mp->maxsz)
+      return -1;
+
+   if (mp->rdmflg)
+      memcpy(buf, mp->storage + addr, size);
+   else /* Sequential access device */
+      for (i = 0; i < size; i++)
+         if (MEMPHY_seq_read(mp, addr + i, &buf[i]) != 0)
+            return -1;
+
+   return 0;
+}
+
+/*
+ *  MEMPHY_write_range - write [size] bytes from [addr] on
+ *  @mp: memphy struct
+ *  @addr: address
+ *  @buf: written values
+ *  @size: number of bytes
+ */
+int MEMPHY_write_range(struct memphy_struct *mp, int addr, const BYTE *buf, int size)
+{
+   int i;
+
+   if (mp == NULL || addr < 0 || addr + size > mp->maxsz)
+      return -1;
+
+   if (mp->rdmflg)
+      memcpy(mp->storage + addr, buf, size);
+   else /* Sequential access device */
+      for (i = 0; i < size; i++)
+         if (MEMPHY_seq_write(mp, addr + i, buf[i]) != 0)
+            return -1;
+
+   return 0;
+}
+
+/*
+ *  MEMPHY_fill_range - write [value] to [size] bytes from [addr] on
+ *  @mp: memphy struct
+ *  @addr: address
+ *  @value: written value
+ *  @size: number of bytes
+ */
+int MEMPHY_fill_range(struct memphy_struct *mp, int addr, BYTE value, int size)
+{
+   int i;
+
+   if (mp == NULL || addr < 0 || addr + size > mp->maxsz)
+      return -1;
+
+   if (mp->rdmflg)
+      memset(mp->storage + addr, value, size);
+   else /* Sequential access device */
+      for (i = 0; i < size; i++)
+         if (MEMPHY_seq_write(mp, addr + i, value) != 0)
+            return -1;
+
+   return 0;
+}
+
 /*
  *  MEMPHY_format-format MEMPHY device
  *  @mp: memphy struct
@@ -142,13 +219,19 @@ int MEMPHY_format(struct memphy_struct *mp, int pagesz)
 
 int MEMPHY_get_freefp(struct memphy_struct *mp, int *retfpn)
 {
-   struct framephy_struct *fp = mp->free_fp_list;
+   struct framephy_struct *fp;
 
+   pthread_mutex_lock(&fp_lock);
+   fp = mp->free_fp_list;
    if (fp == NULL)
+   {
+      pthread_mutex_unlock(&fp_lock);
       return -1;
+   }
 
    *retfpn = fp->fpn;
    mp->free_fp_list = fp->fp_next;
+   pthread_mutex_unlock(&fp_lock);
 
    /* MEMPHY is iteratively used up until its exhausted
     * No garbage collector acting then it not been released
@@ -178,13 +261,14 @@ int MEMPHY_dump(struct memphy_struct *mp)
 
 int MEMPHY_put_freefp(struct memphy_struct *mp, int fpn)
 {
-   struct framephy_struct *fp = mp->free_fp_list;
    struct framephy_struct *newnode = malloc(sizeof(struct framephy_struct));
 
    /* Create new node with value fpn */
    newnode->fpn = fpn;
-   newnode->fp_next = fp;
+   pthread_mutex_lock(&fp_lock);
+   newnode->fp_next = mp->free_fp_list;
    mp->free_fp_list = newnode;
+   pthread_mutex_unlock(&fp_lock);
 
    return 0;
 }
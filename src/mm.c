@@ -5,8 +5,10 @@
  */
 
 #include "mm.h"
+#include "tlb.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 /*
  * init_pte - Initialize PTE entry
@@ -99,6 +101,7 @@ int vmap_page_range(struct pcb_t *caller,           // process call
   while (fpit != NULL && pgit < pgnum) {
     caller->mm->pgd[pgn + pgit] = 0; // Initialize the page table entry
     pte_set_fpn(&caller->mm->pgd[pgn + pgit], fpit->fpn); // Set frame page number
+    tlb_shootdown(caller->pid, pgn + pgit);
     fpit = fpit->fp_next;
     pgit++;
   }
@@ -111,6 +114,33 @@ int vmap_page_range(struct pcb_t *caller,           // process call
   return 0;
 }
 
+/*
+ * swap_out_victim - move the oldest page of caller in ram to swap
+ * @caller : caller
+ * @retfpn : the frame it leaves free
+ */
+static int swap_out_victim(struct pcb_t *caller, int *retfpn)
+{
+  int vicpgn, swpfpn, vicfpn;
+
+  if (MEMPHY_get_freefp(caller->active_mswp, &swpfpn) != 0)
+    return -1; // No free frame in swap space
+
+  if (find_victim_page(caller->mm, &vicpgn) != 0)
+  {
+    MEMPHY_put_freefp(caller->active_mswp, swpfpn);
+    return -1; // None of our pages is in ram
+  }
+
+  vicfpn = PAGING_PTE_FPN(caller->mm->pgd[vicpgn]);
+  __swap_cp_page(caller->mram, vicfpn, caller->active_mswp, swpfpn);
+  pte_set_swap(&caller->mm->pgd[vicpgn], 0, swpfpn);
+  tlb_shootdown(caller->pid, vicpgn);
+
+  *retfpn = vicfpn;
+  return 0;
+}
+
 /*
  * alloc_pages_range - allocate req_pgnum of frame in ram
  * @caller    : caller
@@ -126,8 +156,10 @@ int alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_struc
 
   for (pgit = 0; pgit < req_pgnum; pgit++)
   {
-    // Attempt to get a free frame from physical memory
-    if (MEMPHY_get_freefp(caller->mram, &fpn) == 0)
+    // Attempt to get a free frame from physical memory, or make room by
+    // swapping out the oldest page of the caller
+    if (MEMPHY_get_freefp(caller->mram, &fpn) == 0 ||
+        swap_out_victim(caller, &fpn) == 0)
     {
       // Allocate a new framephy_struct for the frame
       newfp_str = (struct framephy_struct *)malloc(sizeof(struct framephy_struct));
@@ -230,13 +262,16 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
 {
   struct vm_area_struct *vma0 = malloc(sizeof(struct vm_area_struct));
 
-  mm->pgd = malloc(PAGING_MAX_PGN * sizeof(uint32_t));
+  mm->pgd = calloc(PAGING_MAX_PGN, sizeof(uint32_t));
+  mm->fifo_pgn = NULL;
+  memset(mm->symrgtbl, 0, sizeof(mm->symrgtbl));
 
   /* By default the owner comes with at least one vma */
   vma0->vm_id = 0;
   vma0->vm_start = 0;
   vma0->vm_end = vma0->vm_start;
   vma0->sbrk = vma0->vm_start;
+  vma0->vm_freerg_list = NULL;
   struct vm_rg_struct *first_rg = init_vm_rg(vma0->vm_start, vma0->vm_end);
   enlist_vm_rg_node(&vma0->vm_freerg_list, first_rg);
 
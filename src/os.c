@@ -4,17 +4,46 @@
 #include "sched.h"
 #include "loader.h"
 #include "mm.h"
+#include "des.h"
+#include "pgio.h"
+#include "tlb.h"
 
 #include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 static int time_slot;
 static int num_cpus;
 static int done = 0;
 
+/* Maximum number of slots a CPU may run between two barriers */
+static int batch_slots = 1;
+
+/* Run the CPUs and the loader on the discrete-event engine instead of
+ * one thread each, with that many host threads */
+static int des_workers = 0;
+
+/* Give each CPU its own run queue, -1 leaves it to the policy */
+static int percpu_rq = -1;
+
+/* Host threads parsing the programs ahead of their admission, 0
+ * parses each one when the loader reaches it. By default one per host
+ * core the simulation leaves, up to MAX_PARSE_THREADS. */
+#define MAX_PARSE_THREADS 4
+static int parse_threads = -1;
+
+/* Print the scheduler counters at the end */
+static int show_stats = 0;
+
+/* CPUs that did not stop yet, the I/O worker stops after them */
+static _Atomic int nr_cpus_running;
+
 #ifdef MM_PAGING
+/* Cycles a TLB miss is modeled to cost, 0 turns the TLBs off */
+static int tlb_walk = 20;
+
 static int memramsz;
 static int memswpsz[PAGING_MAX_MMSWP];
 
@@ -29,117 +58,491 @@ struct mmpaging_ld_args {
 };
 #endif
 
-static struct ld_args{
-	char ** path;
-	unsigned long * start_time;
-#ifdef MLQ_SCHED
-	unsigned long * prio;
-#endif
+/* A process line of the config */
+struct ld_entry {
+	char * path;
+	unsigned long start_time;
+	unsigned long prio;
+	unsigned long rt_period;	// 0 for an ordinary process
+	unsigned long rt_budget;
+	int seq;			// Line of the process in the config
+};
+
+/* The processes not admitted yet, in a min-heap by start time then by
+ * order in the config, so the config does not have to be sorted */
+static struct {
+	struct ld_entry * heap;
+	int size;
+	int cap;
 } ld_processes;
 int num_processes;
 
 struct cpu_args {
 	struct timer_id_t * timer_id;
 	int id;
+	/* State kept from one step to the next */
+	struct pcb_t * proc;
+	int time_left;
+	int ran;		// Slots and system or memory instructions of
+	int io;			// the current slice
+	int ahead;		// Slots run ahead in the last step, see
+	uint64_t batch_end;	// cpu_step(), and the slot they end before
 };
 
+/* Dispatch the next process, freeing the killed ones on the way */
+static struct pcb_t * next_proc(int id) {
+	struct pcb_t * proc;
+	while ((proc = get_proc()) != NULL && proc->state == PROC_KILLED) {
+		printf("\tCPU %d: Process %2d was killed\n", id, proc->pid);
+		sched_proc_exit(proc);
+		unload(proc);
+	}
+	return proc;
+}
+
+/* Simulate one time slot of a CPU. Return how many slots the CPU is
+ * busy, DES_IDLE when it has nothing to run or DES_STOP once it stopped. */
+static uint64_t cpu_step(void * args) {
+	struct cpu_args * cpu = (struct cpu_args*)args;
+	int id = cpu->id;
+	int time_left = cpu->time_left;
+	int slots;
+	struct pcb_t * proc = cpu->proc;
+
+	sched_set_cpu(id);
+#ifdef MM_PAGING
+	tlb_set_cpu(id);
+#endif
+
+	/* Settle the slots run ahead in the last step. If the clock called
+	 * us back before their end, the CALC instructions of the slots not
+	 * reached yet are taken back: they touched nothing but the process,
+	 * so the other CPUs cannot tell. */
+	if (cpu->ahead > 0) {
+		uint64_t now = current_time();
+		int back = (cpu->batch_end > now) ? cpu->batch_end - now : 0;
+		proc->pc -= back;
+		time_left += back;
+		cpu->ran += cpu->ahead - back;
+		sched_account(proc, cpu->ahead - back);
+		cpu->ahead = 0;
+	}
+
+	/* Check the status of current process */
+	if (proc == NULL) {
+		/* No process is running, the we load new process from
+	 	* ready queue */
+		proc = next_proc(id);
+	}else if (proc->pc == proc->code->size) {
+		/* The porcess has finish it job */
+		printf("\tCPU %d: Processed %2d has finished\n",
+			id ,proc->pid);
+		sched_proc_exit(proc);
+		unload(proc);
+		proc = next_proc(id);
+		time_left = 0;
+	}else if (proc->state == PROC_KILLED) {
+		printf("\tCPU %d: Process %2d was killed\n", id, proc->pid);
+		sched_proc_exit(proc);
+		unload(proc);
+		proc = next_proc(id);
+		time_left = 0;
+	}else if (time_left == 0 || sched_preempt(proc)) {
+		/* The process has done its job in current time slot, or a
+		 * real-time process has to run now */
+		printf("\tCPU %d: Put process %2d to run queue\n",
+			id, proc->pid);
+		sched_slice_end(proc, cpu->ran, cpu->io, time_left == 0);
+		put_proc(proc);
+		proc = next_proc(id);
+		time_left = 0;
+	}
+	cpu->proc = proc;
+	cpu->time_left = time_left;
+
+	/* Recheck process status after loading new process */
+	if (proc == NULL && done && queue_empty()) {
+		/* No process to run, exit */
+		printf("\tCPU %d stopped\n", id);
+		atomic_fetch_sub(&nr_cpus_running, 1);
+		return DES_STOP;
+	}else if (proc == NULL) {
+		/* There may be new processes to run in
+		 * next time slots, just skip current slot. Nothing
+		 * wakes us up before somebody enqueues a process. */
+		return queue_empty() ? DES_IDLE : 1;
+	}else if (time_left == 0) {
+		printf("\tCPU %d: Dispatched process %2d\n",
+			id, proc->pid);
+		time_left = sched_quantum(proc, time_slot);
+		cpu->ran = cpu->io = 0;
+		if (proc->warmup > 0) {
+			/* Its cache lines are on the CPU it came from, the
+			 * process only starts once they are brought over */
+			slots = proc->warmup;
+			proc->warmup = 0;
+			printf("\tCPU %d: Process %2d migrated, warming up for %d slots\n",
+				id, proc->pid, slots);
+			cpu->time_left = time_left;
+			return slots;
+		}
+	}
+
+	/* Run current process */
+	if (proc->pc < proc->code->size &&
+			proc->code->text[proc->pc].opcode != CALC) {
+		cpu->io++;
+	}
+	run(proc);
+	time_left--;
+#ifdef MM_PAGING
+	if (proc->state == PROC_BLOCKED) {
+		/* Page fault, the process waits for the I/O worker and the
+		 * CPU runs another one */
+		printf("\tCPU %d: Process %2d blocked on a page fault\n",
+			id, proc->pid);
+		sched_tick(proc, 1);
+		sched_slice_end(proc, cpu->ran + 1, cpu->io, 0);
+		cpu->proc = NULL;
+		cpu->time_left = 0;
+		pgio_submit(proc);
+		return 1;
+	}
+#endif
+
+	cpu->ran++;
+	sched_tick(proc, 1);
+
+	/* Instructions that only touch the process itself may run
+	 * ahead of the other CPUs, this CPU then stays out of the
+	 * barrier until the slot of the last one is over. Anything
+	 * shared still happens in its own slot. The batch stops short
+	 * of the slots in which the scheduler looks at every running
+	 * process, and cpu_recall() brings the CPU back when another one
+	 * kills or preempts its process, so the schedule is the same as
+	 * with one instruction per barrier. */
+	slots = 1;
+	if (batch_slots > 1 && time_left > 0) {
+		cpu->ahead = run_local(proc, sched_batch(proc,
+			(time_left < batch_slots - 1) ? time_left :
+			batch_slots - 1));
+		cpu->batch_end = current_time() + 1 + cpu->ahead;
+		time_left -= cpu->ahead;
+		slots += cpu->ahead;
+	}
+	cpu->time_left = time_left;
+	return slots;
+}
+
+/* Whether the CPU away for a batch has to be back in [slot] already: its
+ * process was killed, has to make room for a real-time one, or the batch
+ * runs past a slot the scheduler has to see it in. In the last case the
+ * CPU starts a shorter batch once back. */
+static int cpu_recall(void * args, uint64_t slot) {
+	struct cpu_args * cpu = (struct cpu_args*)args;
+
+	return cpu->ahead > 0 && slot < cpu->batch_end &&
+		(cpu->proc->state == PROC_KILLED || sched_preempt(cpu->proc) ||
+		 sched_batch_over(cpu->batch_end));
+}
 
 static void * cpu_routine(void * args) {
 	struct timer_id_t * timer_id = ((struct cpu_args*)args)->timer_id;
-	int id = ((struct cpu_args*)args)->id;
-	/* Check for new process in ready queue */
-	int time_left = 0;
-	struct pcb_t * proc = NULL;
-	while (1) {
-		/* Check the status of current process */
-		if (proc == NULL) {
-			/* No process is running, the we load new process from
-		 	* ready queue */
-			proc = get_proc();
-			if (proc == NULL) {
-                           next_slot(timer_id);
-                           continue; /* First load failed. skip dummy load */
-                        }
-		}else if (proc->pc == proc->code->size) {
-			/* The porcess has finish it job */
-			printf("\tCPU %d: Processed %2d has finished\n",
-				id ,proc->pid);
-			free(proc);
-			proc = get_proc();
-			time_left = 0;
-		}else if (time_left == 0) {
-			/* The process has done its job in current time slot */
-			printf("\tCPU %d: Put process %2d to run queue\n",
-				id, proc->pid);
-			put_proc(proc);
-			proc = get_proc();
+	uint64_t slots;
+
+	while ((slots = cpu_step(args)) != DES_STOP) {
+		if (slots == DES_IDLE) {
+			next_slot_idle(timer_id, TIMER_NEVER);
+		}else{
+			next_slots(timer_id, slots);
 		}
-		
-		/* Recheck process status after loading new process */
-		if (proc == NULL && done) {
-			/* No process to run, exit */
-			printf("\tCPU %d stopped\n", id);
-			break;
-		}else if (proc == NULL) {
-			/* There may be new processes to run in
-			 * next time slots, just skip current slot */
-			next_slot(timer_id);
-			continue;
-		}else if (time_left == 0) {
-			printf("\tCPU %d: Dispatched process %2d\n",
-				id, proc->pid);
-			time_left = time_slot;
+	}
+	detach_event(timer_id);
+	pthread_exit(NULL);
+}
+
+#ifdef MM_PAGING
+/* Simulate one time slot of the I/O worker serving the page faults.
+ * Return the number of slots until the next request is done. */
+static uint64_t io_step(void * args) {
+	uint64_t now = current_time();
+	uint64_t next = pgio_run(now);
+
+	if (next != TIMER_NEVER) {
+		return next - now;
+	}
+	return atomic_load(&nr_cpus_running) ? DES_IDLE : DES_STOP;
+}
+
+static void * io_routine(void * args) {
+	struct timer_id_t * timer_id = (struct timer_id_t *)args;
+	uint64_t slots;
+
+	while ((slots = io_step(args)) != DES_STOP) {
+		if (slots == DES_IDLE) {
+			next_slot_idle(timer_id, TIMER_NEVER);
+		}else{
+			next_slots(timer_id, slots);
 		}
-		
-		/* Run current process */
-		run(proc);
-		time_left--;
-		next_slot(timer_id);
 	}
 	detach_event(timer_id);
 	pthread_exit(NULL);
 }
+#endif
 
-static void * ld_routine(void * args) {
+/* Loader progress kept from one step to the next */
+struct ld_state {
+	struct timer_id_t * timer_id;
 #ifdef MM_PAGING
-	struct memphy_struct* mram = ((struct mmpaging_ld_args *)args)->mram;
-	struct memphy_struct** mswp = ((struct mmpaging_ld_args *)args)->mswp;
-	struct memphy_struct* active_mswp = ((struct mmpaging_ld_args *)args)->active_mswp;
-	struct timer_id_t * timer_id = ((struct mmpaging_ld_args *)args)->timer_id;
-#else
-	struct timer_id_t * timer_id = (struct timer_id_t*)args;
+	struct mmpaging_ld_args * mm;
 #endif
-	int i = 0;
-	printf("ld_routine\n");
-	while (i < num_processes) {
-		struct pcb_t * proc = load(ld_processes.path[i]);
+	int started;
+	struct ld_entry next;	// Next process to admit, once loaded
+	struct pcb_t * proc;	// Loaded, waiting for its start time
+};
+
+static int ld_before(const struct ld_entry * a, const struct ld_entry * b) {
+	if (a->start_time != b->start_time) {
+		return a->start_time < b->start_time;
+	}
+	return a->seq < b->seq;
+}
+
+static void ld_push(struct ld_entry * e) {
+	int i;
+	if (ld_processes.size == ld_processes.cap) {
+		ld_processes.cap = ld_processes.cap ? 2 * ld_processes.cap : 64;
+		ld_processes.heap = realloc(ld_processes.heap,
+			ld_processes.cap * sizeof(struct ld_entry));
+	}
+	for (i = ld_processes.size++;
+			i > 0 && ld_before(e, &ld_processes.heap[(i - 1) / 2]);
+			i = (i - 1) / 2) {
+		ld_processes.heap[i] = ld_processes.heap[(i - 1) / 2];
+	}
+	ld_processes.heap[i] = *e;
+}
+
+static void ld_pop(struct ld_entry * e) {
+	struct ld_entry * h = ld_processes.heap;
+	struct ld_entry last = h[--ld_processes.size];
+	int i = 0, child;
+
+	*e = h[0];
+	while ((child = 2 * i + 1) < ld_processes.size) {
+		if (child + 1 < ld_processes.size &&
+				ld_before(&h[child + 1], &h[child])) {
+			child++;
+		}
+		if (!ld_before(&h[child], &last)) {
+			break;
+		}
+		h[i] = h[child];
+		i = child;
+	}
+	h[i] = last;
+}
+
+/* Simulate one time slot of the loader, admits at most one process.
+ * Return the number of slots until the next admission or DES_STOP
+ * once every process was admitted. The programs were parsed ahead by
+ * loader_prefetch(), load() only makes the PCB. */
+static uint64_t ld_step(void * args) {
+	struct ld_state * ld = (struct ld_state*)args;
+	struct ld_entry * e = &ld->next;
+	struct pcb_t * proc;
+
+	if (!ld->started) {
+		printf("ld_routine\n");
+		ld->started = 1;
+	}
+	if (ld->proc == NULL && ld_processes.size == 0) {
+		free(ld_processes.heap);
+		ld_processes.heap = NULL;
+		done = 1;
+		return DES_STOP;
+	}
+	if (ld->proc == NULL) {
+		ld_pop(e);
+		ld->proc = load(e->path);
 #ifdef MLQ_SCHED
-		proc->prio = ld_processes.prio[i];
+		ld->proc->prio = e->prio;
 #endif
-		while (current_time() < ld_processes.start_time[i]) {
-			next_slot(timer_id);
-		}
+		ld->proc->rt_period = e->rt_period;
+		ld->proc->rt_budget = e->rt_budget;
+	}
+	if (current_time() < e->start_time) {
+		return e->start_time - current_time();
+	}
+
+	proc = ld->proc;
 #ifdef MM_PAGING
-		proc->mm = malloc(sizeof(struct mm_struct));
-		init_mm(proc->mm, proc);
-		proc->mram = mram;
-		proc->mswp = mswp;
-		proc->active_mswp = active_mswp;
+	proc->mm = malloc(sizeof(struct mm_struct));
+	init_mm(proc->mm, proc);
+	proc->mram = ld->mm->mram;
+	proc->mswp = ld->mm->mswp;
+	proc->active_mswp = ld->mm->active_mswp;
 #endif
-		printf("\tLoaded a process at %s, PID: %d PRIO: %ld\n",
-			ld_processes.path[i], proc->pid, ld_processes.prio[i]);
-		add_proc(proc);
-		free(ld_processes.path[i]);
-		i++;
-		next_slot(timer_id);
-	}
-	free(ld_processes.path);
-	free(ld_processes.start_time);
-	done = 1;
+	printf("\tLoaded a process at %s, PID: %d PRIO: %ld\n",
+		e->path, proc->pid, e->prio);
+	if (proc->rt_period > 0) {
+		/* Admission control, a process the CPUs cannot serve in
+		 * time runs as an ordinary one */
+		if (sched_rt_admit(proc) == 0) {
+			printf("\tProcess %2d is real-time, %u slots every %u\n",
+				proc->pid, proc->rt_budget, proc->rt_period);
+		}else{
+			printf("\tProcess %2d rejected as real-time\n",
+				proc->pid);
+		}
+	}
+	add_proc(proc);
+	free(e->path);
+	ld->proc = NULL;
+	return 1;
+}
+
+static void * ld_routine(void * args) {
+	struct timer_id_t * timer_id = ((struct ld_state*)args)->timer_id;
+	uint64_t slots;
+
+	/* The loader stays out of the barrier until the start time of the
+	 * next process, the clock may jump there if every CPU is idle */
+	while ((slots = ld_step(args)) != DES_STOP) {
+		next_slots(timer_id, slots);
+	}
 	detach_event(timer_id);
 	pthread_exit(NULL);
 }
 
+/* Optional lines between the memory sizes and the process list. Each
+ * one is a keyword followed by its values:
+ *        batch K         run up to K slots per CPU between barriers
+ *        sched NAME      scheduling policy, mlq, mlq_lf, cfs or fifo
+ *        migration N     slots lost when a process changes CPU
+ *        balance N [T]   balance the per-CPU run queues every N slots
+ *                        when they are more than T percent apart
+ *        quantum adaptive [MIN MAX [SPREAD]]
+ *                        adapt each slice between MIN and MAX slots,
+ *                        moving priorities by up to SPREAD levels
+ *        pagefault async [N]
+ *                        block faulting processes, an I/O worker
+ *                        brings their pages in N slots each
+ *        loader N        parse the programs on N host threads ahead of
+ *                        their start time, 0 for none
+ *        tlb off | tlb N cache translations on each CPU, a miss
+ *                        being modeled as N cycles (20 by default)
+ */
+static void read_options(FILE * file) {
+	char option[32];
+	long pos;
+	int c;
+
+	while (1) {
+		pos = ftell(file);
+		if (fscanf(file, "%31s", option) != 1) {
+			break;
+		}
+		if (!strcmp(option, "batch")) {
+			fscanf(file, "%d", &batch_slots);
+			if (batch_slots < 1) {
+				batch_slots = 1;
+			}
+		}else if (!strcmp(option, "engine")) {
+			/* engine lockstep | engine des [workers], the worker
+			 * count is optional so stay on this line */
+			char line[64];
+			int workers = 1;
+			if (fgets(line, sizeof(line), file) == NULL) {
+				break;
+			}
+			des_workers = 0;
+			if (sscanf(line, "%31s %d", option, &workers) >= 1 &&
+					!strcmp(option, "des")) {
+				des_workers = (workers < 1) ? 1 : workers;
+			}
+			continue;
+		}else if (!strcmp(option, "runqueue")) {
+			/* runqueue global | runqueue percpu */
+			fscanf(file, "%31s", option);
+			percpu_rq = !strcmp(option, "percpu");
+		}else if (!strcmp(option, "sched")) {
+			fscanf(file, "%31s", option);
+			if (sched_set_policy(option) < 0) {
+				fprintf(stderr, "Unknown policy %s\n", option);
+			}
+		}else if (!strcmp(option, "migration")) {
+			int cost = 0;
+			fscanf(file, "%d", &cost);
+			sched_set_migration_cost(cost);
+		}else if (!strcmp(option, "balance")) {
+			/* The threshold is optional so stay on this line */
+			char line[64];
+			int interval = 0, threshold = -1;
+			if (fgets(line, sizeof(line), file) == NULL) {
+				break;
+			}
+			sscanf(line, "%d %d", &interval, &threshold);
+			sched_set_balance(interval, threshold);
+			continue;
+		}else if (!strcmp(option, "quantum")) {
+			/* quantum fixed | quantum adaptive [MIN MAX [SPREAD]] */
+			char line[64];
+			int min = 1, max = 4 * time_slot, spread = 8;
+			if (fgets(line, sizeof(line), file) == NULL) {
+				break;
+			}
+			if (sscanf(line, "%31s %d %d %d", option, &min, &max,
+					&spread) >= 1 && !strcmp(option, "adaptive")) {
+				sched_set_quantum(min, max, spread);
+			}else{
+				sched_set_quantum(0, 0, 0);
+			}
+			continue;
+		}else if (!strcmp(option, "pagefault")) {
+			/* pagefault sync | pagefault async [latency] */
+			char line[64];
+			int latency = 4;
+			if (fgets(line, sizeof(line), file) == NULL) {
+				break;
+			}
+			if (sscanf(line, "%31s %d", option, &latency) >= 1 &&
+					!strcmp(option, "async")) {
+				pgio_set_latency(latency < 1 ? 1 : latency);
+			}else{
+				pgio_set_latency(0);
+			}
+			continue;
+#ifdef MM_PAGING
+		}else if (!strcmp(option, "tlb")) {
+			fscanf(file, "%31s", option);
+			tlb_walk = !strcmp(option, "off") ? 0 : atoi(option);
+#endif
+		}else if (!strcmp(option, "loader")) {
+			fscanf(file, "%d", &parse_threads);
+		}else if (!strcmp(option, "stats")) {
+			show_stats = 1;
+		}else{
+			/* First process line */
+			fseek(file, pos, SEEK_SET);
+			break;
+		}
+		/* Ignore the rest of the line */
+		while ((c = fgetc(file)) != EOF && c != '\n');
+	}
+}
+
+/* [name] under [dir], unless it is an absolute path */
+static char * input_path(const char * dir, const char * name) {
+	char * path;
+	if (name[0] == '/') {
+		dir = "";
+	}
+	path = malloc(strlen(dir) + strlen(name) + 1);
+	sprintf(path, "%s%s", dir, name);
+	return path;
+}
+
 static void read_config(const char * path) {
 	FILE * file;
 	if ((file = fopen(path, "r")) == NULL) {
@@ -147,9 +550,6 @@ static void read_config(const char * path) {
 		exit(1);
 	}
 	fscanf(file, "%d %d %d\n", &time_slot, &num_cpus, &num_processes);
-	ld_processes.path = (char**)malloc(sizeof(char*) * num_processes);
-	ld_processes.start_time = (unsigned long*)
-		malloc(sizeof(unsigned long) * num_processes);
 #ifdef MM_PAGING
 	int sit;
 #ifdef MM_FIXED_MEMSZ
@@ -167,31 +567,75 @@ static void read_config(const char * path) {
 	 * Format: (size=0 result non-used memswap, must have RAM and at least 1 SWAP)
 	 *        MEM_RAM_SZ MEM_SWP0_SZ MEM_SWP1_SZ MEM_SWP2_SZ MEM_SWP3_SZ
 	*/
-	fscanf(file, "%d\n", &memramsz);
-	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++)
-		fscanf(file, "%d", &(memswpsz[sit])); 
-
-       fscanf(file, "\n"); /* Final character */
+	char line[256];
+	char * p = line, * end;
+	long pos = ftell(file);
+	if (fgets(line, sizeof(line), file) == NULL) {
+		line[0] = '\0';
+	}
+	for (sit = -1; sit < PAGING_MAX_MMSWP; sit++) {
+		int sz = strtol(p, &end, 10);
+		if (end == p) {
+			break;
+		}
+		if (sit < 0) {
+			memramsz = sz;
+		}else{
+			memswpsz[sit] = sz;
+		}
+		p = end;
+	}
+	if (sit < PAGING_MAX_MMSWP) {
+		/* No memory line, this is a legacy config. Use the sizes
+		 * of MM_FIXED_MEMSZ and read the line again as a process. */
+		fseek(file, pos, SEEK_SET);
+		memramsz    =  0x100000;
+		memswpsz[0] = 0x1000000;
+		for(sit = 1; sit < PAGING_MAX_MMSWP; sit++)
+			memswpsz[sit] = 0;
+	}
 #endif
 #endif
 
+	read_options(file);
+
+	/* One process per line, START PATH [PRIO [PERIOD BUDGET]]: a period
+	 * and a budget after the priority make it a real-time process.
+	 * Blank lines are skipped, the lines are streamed up to the count
+	 * of the first line, or to the end of the file if it is 0. */
+	char * buf = NULL;
+	size_t cap = 0;
+	int limit = num_processes;
+	num_processes = 0;
+	while ((limit <= 0 || num_processes < limit) &&
+			getline(&buf, &cap, file) != -1) {
+		struct ld_entry e;
+		char * save, * name;
+		char * tok = strtok_r(buf, " \t\r\n", &save);
+
+		if (tok == NULL ||
+				(name = strtok_r(NULL, " \t\r\n", &save)) == NULL) {
+			continue;
+		}
+		memset(&e, 0, sizeof(e));
+		e.start_time = strtoul(tok, NULL, 10);
+		if ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+			e.prio = strtoul(tok, NULL, 10);
+		}
 #ifdef MLQ_SCHED
-	ld_processes.prio = (unsigned long*)
-		malloc(sizeof(unsigned long) * num_processes);
-#endif
-	int i;
-	for (i = 0; i < num_processes; i++) {
-		ld_processes.path[i] = (char*)malloc(sizeof(char) * 100);
-		ld_processes.path[i][0] = '\0';
-		strcat(ld_processes.path[i], "input/proc/");
-		char proc[100];
-#ifdef MLQ_SCHED
-		fscanf(file, "%lu %s %lu\n", &ld_processes.start_time[i], proc, &ld_processes.prio[i]);
-#else
-		fscanf(file, "%lu %s\n", &ld_processes.start_time[i], proc);
+		if ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+			e.rt_period = strtoul(tok, NULL, 10);
+			if ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+				e.rt_budget = strtoul(tok, NULL, 10);
+			}
+		}
 #endif
-		strcat(ld_processes.path[i], proc);
+		e.path = input_path("input/proc/", name);
+		e.seq = num_processes++;
+		ld_push(&e);
 	}
+	free(buf);
+	fclose(file);
 }
 
 int main(int argc, char * argv[]) {
@@ -200,25 +644,55 @@ int main(int argc, char * argv[]) {
 		printf("Usage: os [path to configure file]\n");
 		return 1;
 	}
-	char path[100];
-	path[0] = '\0';
-	strcat(path, "input/");
-	strcat(path, argv[1]);
+	char * path = input_path("input/", argv[1]);
 	read_config(path);
+	free(path);
+	if (parse_threads < 0) {
+		parse_threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+		if (parse_threads > MAX_PARSE_THREADS) {
+			parse_threads = MAX_PARSE_THREADS;
+		}
+	}
+	/* The heap is nearly in order of start time already */
+	char ** paths = malloc((num_processes + 1) * sizeof(char *));
+	int n;
+	for (n = 0; n < num_processes; n++) {
+		paths[n] = ld_processes.heap[n].path;
+	}
+	loader_prefetch(paths, num_processes, parse_threads);
+	free(paths);
 
 	pthread_t * cpu = (pthread_t*)malloc(num_cpus * sizeof(pthread_t));
 	struct cpu_args * args =
 		(struct cpu_args*)malloc(sizeof(struct cpu_args) * num_cpus);
+	struct ld_state ld_args;
 	pthread_t ld;
+#ifdef MM_PAGING
+	struct timer_id_t * io_timer = NULL;
+	pthread_t io;
+#endif
 	
-	/* Init timer */
+	/* Init timer, the event engine runs the devices itself */
 	int i;
 	for (i = 0; i < num_cpus; i++) {
-		args[i].timer_id = attach_event();
+		args[i].timer_id = des_workers ? NULL : attach_event();
 		args[i].id = i;
+		args[i].proc = NULL;
+		args[i].time_left = 0;
+		args[i].ahead = 0;
+		if (args[i].timer_id != NULL) {
+			set_recall(args[i].timer_id, cpu_recall, &args[i]);
+		}
 	}
-	struct timer_id_t * ld_event = attach_event();
-	start_timer();
+	ld_args.timer_id = des_workers ? NULL : attach_event();
+	atomic_store(&nr_cpus_running, num_cpus);
+#ifdef MM_PAGING
+	if (pgio_async() && !des_workers) {
+		io_timer = attach_event();
+	}
+#endif
+	ld_args.started = 0;
+	ld_args.proc = NULL;
 
 #ifdef MM_PAGING
 	/* Init all MEMPHY include 1 MEMRAM and n of MEMSWP */
@@ -238,39 +712,83 @@ int main(int argc, char * argv[]) {
 	/* In Paging mode, it needs passing the system mem to each PCB through loader*/
 	struct mmpaging_ld_args *mm_ld_args = malloc(sizeof(struct mmpaging_ld_args));
 
-	mm_ld_args->timer_id = ld_event;
+	mm_ld_args->timer_id = ld_args.timer_id;
 	mm_ld_args->mram = (struct memphy_struct *) &mram;
 	mm_ld_args->mswp = (struct memphy_struct**) &mswp;
 	mm_ld_args->active_mswp = (struct memphy_struct *) &mswp[0];
         mm_ld_args->active_mswp_id = 0;
+	ld_args.mm = mm_ld_args;
 #endif
 
 	/* Init scheduler */
+	if (percpu_rq > 0 || (percpu_rq < 0 && sched_policy_percpu())) {
+		sched_use_percpu(num_cpus);
+	}
+	sched_set_capacity(num_processes);
+	sched_set_nr_cpus(num_cpus);
 	init_scheduler();
+#ifdef MM_PAGING
+	tlb_init(num_cpus, tlb_walk);
+#endif
 
 	/* Run CPU and loader */
+	if (des_workers) {
+		/* CPUs go before the loader, a process loaded in a slot is
+		 * dispatched in the next one like in lockstep mode */
+		for (i = 0; i < num_cpus; i++) {
+			des_add_actor(cpu_step, &args[i]);
+			des_set_recall(&args[i], cpu_recall);
+		}
+		des_add_actor(ld_step, &ld_args);
 #ifdef MM_PAGING
-	pthread_create(&ld, NULL, ld_routine, (void*)mm_ld_args);
-#else
-	pthread_create(&ld, NULL, ld_routine, (void*)ld_event);
+		if (pgio_async()) {
+			des_add_actor(io_step, NULL);
+		}
 #endif
-	for (i = 0; i < num_cpus; i++) {
-		pthread_create(&cpu[i], NULL,
-			cpu_routine, (void*)&args[i]);
-	}
+		des_run(des_workers);
+	}else{
+		start_timer();
+		pthread_create(&ld, NULL, ld_routine, (void*)&ld_args);
+#ifdef MM_PAGING
+		if (io_timer != NULL) {
+			pthread_create(&io, NULL, io_routine, (void*)io_timer);
+		}
+#endif
+		for (i = 0; i < num_cpus; i++) {
+			pthread_create(&cpu[i], NULL,
+				cpu_routine, (void*)&args[i]);
+		}
 
-	/* Wait for CPU and loader finishing */
-	for (i = 0; i < num_cpus; i++) {
-		pthread_join(cpu[i], NULL);
+		/* Wait for CPU and loader finishing */
+		for (i = 0; i < num_cpus; i++) {
+			pthread_join(cpu[i], NULL);
+		}
+		pthread_join(ld, NULL);
+#ifdef MM_PAGING
+		if (io_timer != NULL) {
+			pthread_join(io, NULL);
+		}
+#endif
+
+		/* Stop timer */
+		stop_timer();
 	}
-	pthread_join(ld, NULL);
 
-	/* Stop timer */
-	stop_timer();
+	if (show_stats) {
+		print_sched_stats();
+		loader_stats();
+#ifdef MM_PAGING
+		pgio_stats();
+		tlb_stats();
+#endif
+	}
+	finish_scheduler();
+#ifdef MM_PAGING
+	tlb_fini();
+#endif
 
 	return 0;
 
 }
 
 
-
@@ -0,0 +1,74 @@
+#include "pgio.h"
+#include "mm.h"
+#include "sched.h"
+#include "timer.h"
+
+#include <pthread.h>
+
+#ifdef MM_PAGING
+static pthread_mutex_t pgio_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct list_head pgio_queue = LIST_HEAD_INIT(pgio_queue);
+static int pgio_latency;
+static uint64_t pgio_free;	// Slot the worker is done with the queue
+
+static unsigned long nr_faults;
+static unsigned long nr_failed;
+static uint64_t blocked_slots;
+
+void pgio_set_latency(int slots) {
+	pgio_latency = (slots < 0) ? 0 : slots;
+}
+
+int pgio_async(void) {
+	return pgio_latency > 0;
+}
+
+void pgio_submit(struct pcb_t * proc) {
+	uint64_t now = current_time();
+
+	pthread_mutex_lock(&pgio_lock);
+	if (pgio_free < now) {
+		pgio_free = now;
+	}
+	pgio_free += pgio_latency;
+	proc->io_done = pgio_free;
+	list_add_tail(&proc->io_node, &pgio_queue);
+	nr_faults++;
+	blocked_slots += pgio_free - now;
+	pthread_mutex_unlock(&pgio_lock);
+}
+
+uint64_t pgio_run(uint64_t now) {
+	struct pcb_t * proc;
+	uint64_t next = TIMER_NEVER;
+
+	pthread_mutex_lock(&pgio_lock);
+	while (!list_empty(&pgio_queue)) {
+		proc = list_first_entry(&pgio_queue, struct pcb_t, io_node);
+		if (proc->io_done > now) {
+			next = proc->io_done;
+			break;
+		}
+		list_del_init(&proc->io_node);
+		/* Nobody runs the process, its page table is ours. The
+		 * free frame lists have their own lock. */
+		if (pg_swapin(proc->mm, proc->fault_pgn, proc) != 0) {
+			proc->fault_failed = 1;
+			nr_failed++;
+		}
+		printf("\tI/O: Page %d of process %2d is in\n",
+			proc->fault_pgn, proc->pid);
+		sched_wake(proc);
+	}
+	pthread_mutex_unlock(&pgio_lock);
+	return next;
+}
+
+void pgio_stats(void) {
+	if (nr_faults == 0) {
+		return;
+	}
+	printf("Page faults: %lu, %lu failed, blocked %.1f slots on average\n",
+		nr_faults, nr_failed, (double)blocked_slots / nr_faults);
+}
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Convert a text program of input/proc to the binary format the loader
+ * maps in place, see loader.h.
+ *
+ * Usage: proc2bin <text program> <binary program>
+ */
+
+#include "loader.h"
+#include <stdio.h>
+
+int main(int argc, char * argv[]) {
+	struct code_seg_t * code;
+	uint32_t priority;
+
+	if (argc != 3) {
+		printf("Usage: %s <text program> <binary program>\n", argv[0]);
+		return 1;
+	}
+	code = load_code(argv[1], &priority);
+	if (save_program(argv[2], priority, code) != 0) {
+		printf("Cannot write '%s'\n", argv[2]);
+		return 1;
+	}
+	printf("%s: %u instructions, %zu bytes\n", argv[2], code->size,
+		sizeof(struct prog_header) + code->size * sizeof(struct inst_t));
+	free_code(code);
+	return 0;
+}
@@ -8,31 +8,182 @@ int empty(struct queue_t * q) {
 }
 
 void enqueue(struct queue_t * q, struct pcb_t * proc) {
-        /* TODO: put a new process to queue [q] */
-        if (q == NULL || q->size == MAX_QUEUE_SIZE)
+        if (q == NULL)
           return;
-        q->proc[q->size] = proc;
+        if (q->size == q->cap) {
+          /* Unroll the ring into a buffer twice as large */
+          int cap = q->cap ? 2 * q->cap : QUEUE_INIT_SIZE;
+          struct pcb_t ** buf = malloc(cap * sizeof(struct pcb_t *));
+          for (int i = 0; i < q->size; i++) {
+            buf[i] = q->proc[(q->head + i) & (q->cap - 1)];
+          }
+          free(q->proc);
+          q->proc = buf;
+          q->head = 0;
+          q->cap = cap;
+        }
+        q->proc[(q->head + q->size) & (q->cap - 1)] = proc;
         q->size++;
 }
 
 struct pcb_t * dequeue(struct queue_t * q) {
-        /* TODO: return a pcb whose prioprity is the highest
-         * in the queue [q] and remember to remove it from q
-         * */
-         if (q == NULL || q->size == 0)
-          return 0;
-        int min_priority_index = 0;
-        for (int i = 1; i < q->size; i++){
-          if (q->proc[i]->priority < q->proc[min_priority_index]->priority){
-            min_priority_index = i;
+        if (q == NULL || q->size == 0)
+          return NULL;
+        struct pcb_t * proc = q->proc[q->head];
+        q->head = (q->head + 1) & (q->cap - 1);
+        q->size--;
+        return proc;
+}
+
+void free_queue(struct queue_t * q) {
+        free(q->proc);
+        q->proc = NULL;
+        q->head = q->size = q->cap = 0;
+}
+
+int pq_empty(struct pqueue_t * q) {
+        if (q == NULL) return 1;
+        return (q->size == 0);
+}
+
+static int pq_before(struct pq_node * a, struct pq_node * b) {
+        if (a->proc->priority != b->proc->priority)
+          return a->proc->priority < b->proc->priority;
+        return a->seq < b->seq;
+}
+
+void pq_enqueue(struct pqueue_t * q, struct pcb_t * proc) {
+        if (q == NULL)
+          return;
+        if (q->size == q->cap) {
+          q->cap = q->cap ? 2 * q->cap : QUEUE_INIT_SIZE;
+          q->heap = realloc(q->heap, q->cap * sizeof(struct pq_node));
+        }
+        /* Sift the new node up from the last leaf */
+        struct pq_node node = { proc, q->seq++ };
+        int i = q->size++;
+        while (i > 0 && pq_before(&node, &q->heap[(i - 1) / 2])) {
+          q->heap[i] = q->heap[(i - 1) / 2];
+          i = (i - 1) / 2;
+        }
+        q->heap[i] = node;
+}
+
+struct pcb_t * pq_dequeue(struct pqueue_t * q) {
+        /* Return the pcb whose prioprity is the highest in the queue
+         * [q] and remove it from q */
+        if (q == NULL || q->size == 0)
+          return NULL;
+        struct pcb_t * proc = q->heap[0].proc;
+        struct pq_node last = q->heap[--q->size];
+        int i = 0;
+        if (q->size == 0)
+          return proc;
+        /* Sift the last leaf down from the root */
+        while (2 * i + 1 < q->size) {
+          int child = 2 * i + 1;
+          if (child + 1 < q->size &&
+              pq_before(&q->heap[child + 1], &q->heap[child]))
+            child++;
+          if (!pq_before(&q->heap[child], &last))
+            break;
+          q->heap[i] = q->heap[child];
+          i = child;
+        }
+        q->heap[i] = last;
+        return proc;
+}
+
+void pq_free(struct pqueue_t * q) {
+        free(q->heap);
+        q->heap = NULL;
+        q->size = q->cap = 0;
+}
+
+void lfq_init(struct lfq_t * q, int cap) {
+        uint64_t n = QUEUE_INIT_SIZE;
+        while (n < (uint64_t)cap)
+          n *= 2;
+        q->cell = malloc(n * sizeof(struct lfq_cell));
+        for (uint64_t i = 0; i < n; i++) {
+          atomic_init(&q->cell[i].seq, i);
+        }
+        q->mask = n - 1;
+        atomic_init(&q->tail, 0);
+        atomic_init(&q->head, 0);
+}
+
+int lfq_push(struct lfq_t * q, struct pcb_t * proc) {
+        uint64_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        struct lfq_cell * cell;
+        while (1) {
+          cell = &q->cell[pos & q->mask];
+          uint64_t seq = atomic_load_explicit(&cell->seq,
+              memory_order_acquire);
+          int64_t dif = (int64_t)(seq - pos);
+          if (dif == 0) {
+            /* The cell is free, claim the position */
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos,
+                pos + 1, memory_order_relaxed, memory_order_relaxed))
+              break;
+          } else if (dif < 0) {
+            /* Still holds the process of the previous lap */
+            return -1;
+          } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
           }
         }
-        struct pcb_t *proc = q->proc[min_priority_index];
-        for (int i = min_priority_index; i < q->size - 1; i++) {
-          q->proc[i] = q->proc[i + 1];
+        cell->proc = proc;
+        atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+        return 0;
+}
+
+struct pcb_t * lfq_pop(struct lfq_t * q) {
+        uint64_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        struct lfq_cell * cell;
+        while (1) {
+          cell = &q->cell[pos & q->mask];
+          uint64_t seq = atomic_load_explicit(&cell->seq,
+              memory_order_acquire);
+          int64_t dif = (int64_t)(seq - (pos + 1));
+          if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos,
+                pos + 1, memory_order_relaxed, memory_order_relaxed))
+              break;
+          } else if (dif < 0) {
+            /* Not filled yet */
+            return NULL;
+          } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+          }
         }
-        q->proc[q->size - 1] = NULL; 
-        q->size--;
+        struct pcb_t * proc = cell->proc;
+        /* Free the cell for the producer of the next lap */
+        atomic_store_explicit(&cell->seq, pos + q->mask + 1,
+            memory_order_release);
+        return proc;
+}
+
+struct pcb_t * lfq_peek(struct lfq_t * q) {
+        uint64_t pos = atomic_load_explicit(&q->head, memory_order_acquire);
+        struct lfq_cell * cell = &q->cell[pos & q->mask];
+        if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + 1)
+          return NULL;
+        struct pcb_t * proc = cell->proc;
+        /* The cell may have been taken and filled again while we read it */
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&cell->seq, memory_order_relaxed) != pos + 1)
+          return NULL;
         return proc;
 }
 
+int lfq_empty(struct lfq_t * q) {
+        if (q == NULL) return 1;
+        return atomic_load(&q->head) >= atomic_load(&q->tail);
+}
+
+void lfq_free(struct lfq_t * q) {
+        free(q->cell);
+        q->cell = NULL;
+        q->mask = 0;
+}
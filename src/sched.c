@@ -1,145 +1,606 @@
 
 #include "queue.h"
 #include "sched.h"
+#include "sched_class.h"
 #include "common.h"
+#include "timer.h"
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include <stdlib.h>
 #include <stdio.h>
-static struct queue_t ready_queue;
-static struct queue_t run_queue;
+#include <string.h>
 static pthread_mutex_t queue_lock;
 
-static struct queue_t running_list;
-static int current =0;
-#ifdef MLQ_SCHED
-static struct queue_t mlq_ready_queue[MAX_PRIO];
-static int slot[MAX_PRIO];
-#endif
+/* Every live process, guarded by queue_lock */
+static struct list_head all_procs = LIST_HEAD_INIT(all_procs);
 
-int queue_empty(void) {
+/* Policies that can be selected by name, the first one is the default */
+static const struct sched_class * const sched_classes[] = {
 #ifdef MLQ_SCHED
-    unsigned long prio;
-    for (prio = 0; prio < MAX_PRIO; prio++)
-        if (!empty(&mlq_ready_queue[prio])) 
-            return -1;
+    &mlq_sched_class,
+    &mlq_lf_sched_class,
+    &cfs_sched_class,
 #endif
-    return (empty(&ready_queue) && empty(&run_queue));
+    &fifo_sched_class,
+};
+
+#define NR_SCHED_CLASSES (sizeof(sched_classes) / sizeof(sched_classes[0]))
+
+static const struct sched_class * policy;
+
+static struct sched_rq * rqs;
+static int nr_rqs = 1;
+static int nr_cpus = 1;
+static int capacity = 1024;
+static _Atomic int nr_queued;
+static _Atomic int nr_blocked;
+
+/* CPU simulated by the calling thread, -1 for the loader */
+static __thread int this_cpu = -1;
+
+/* Slots a CPU stalls for when it dispatches a process that ran on
+ * another CPU last. Local processes are preferred when it is not 0. */
+static int migration_cost;
+static _Atomic unsigned long nr_migrations;
+
+/* Periodic load balancing of the per-CPU run queues. Every
+ * balance_interval slots the ready load of the busiest and the idlest
+ * queue are compared, when they differ by more than balance_threshold
+ * percent of the average load processes are moved from one to the
+ * other. */
+static int balance_interval;
+static int balance_threshold = 25;
+static _Atomic uint64_t next_balance;
+/* Passes run, passes that moved something and processes moved. Only
+ * the CPU running a pass updates them. */
+static unsigned long nr_balance;
+static unsigned long nr_balance_moved;
+static unsigned long nr_balance_procs;
+
+/* Adaptive quantum, see sched_set_quantum(). Off when quantum_max is
+ * 0. */
+static int quantum_min;
+static int quantum_max;
+static int quantum_spread;
+
+/* Every finished process, guarded by queue_lock */
+struct exit_stat {
+    uint32_t pid;
+    uint32_t nr_migrations;
+    uint32_t rt_period;
+    uint32_t rt_missed;
+    uint32_t quantum_lo;
+    uint32_t quantum_hi;
+    uint32_t nr_slices;
+    uint64_t turnaround;
+};
+
+static struct exit_stat * exits;
+static int nr_exits;
+static int max_exits;
+
+static const struct sched_class * sched_class(void) {
+    return policy ? policy : sched_classes[0];
 }
 
-void init_scheduler(void) {
-#ifdef MLQ_SCHED
-    int i;
-    for (i = 0; i < MAX_PRIO; i++) {
-        mlq_ready_queue[i].size = 0;
-        mlq_ready_queue[i].time_slot = MAX_PRIO - i; 
+static struct sched_rq * cpu_rq(void) {
+    return &rqs[(this_cpu >= 0 && this_cpu < nr_rqs) ? this_cpu : 0];
+}
+
+static void rq_lock(struct sched_rq * rq) {
+    if (policy->lockless)
+        return;
+    if (pthread_mutex_trylock(&rq->lock) != 0) {
+        pthread_mutex_lock(&rq->lock);
+        rq->nr_contended++;
     }
-#endif
-    ready_queue.size = 0;
-    run_queue.size = 0;
-    running_list.size = 0;
-    pthread_mutex_init(&queue_lock, NULL);
+    rq->nr_locks++;
 }
 
-#ifdef MLQ_SCHED
-struct pcb_t * get_mlq_proc(void) {
+static void rq_unlock(struct sched_rq * rq) {
+    if (!policy->lockless)
+        pthread_mutex_unlock(&rq->lock);
+}
+
+static void rq_enqueue(struct sched_rq * rq, struct pcb_t * proc, int flags) {
+    policy->enqueue(rq, proc, flags);
+    proc->rq = rq;
+    atomic_fetch_add(&rq->nr_ready, 1);
+    atomic_fetch_add(&rq->load, SCHED_WEIGHT(proc));
+    atomic_fetch_add(&nr_queued, 1);
+}
+
+/* Account for [proc] leaving [rq] */
+static void rq_taken(struct sched_rq * rq, struct pcb_t * proc) {
+    proc->rq = NULL;
+    atomic_fetch_sub(&rq->nr_ready, 1);
+    atomic_fetch_sub(&rq->load, SCHED_WEIGHT(proc));
+    atomic_fetch_sub(&nr_queued, 1);
+}
+
+static struct pcb_t * rq_pick(struct sched_rq * rq) {
+    int cpu = (migration_cost > 0) ? this_cpu : -1;
+    struct pcb_t * proc = policy->pick_next(rq, cpu);
+    if (proc != NULL) {
+        rq_taken(rq, proc);
+        atomic_fetch_add(&rq->nr_dispatch, 1);
+    }
+    return proc;
+}
+
+/* Take a process from the busiest queue other than [self] */
+static struct pcb_t * steal_proc(struct sched_rq * self) {
+    struct sched_rq * busiest = NULL;
     struct pcb_t * proc = NULL;
-    pthread_mutex_lock(&queue_lock);
-   
-    int empty_queue = 0;
-    int all_slots_empty = 1; // Kiểm tra xem tất cả time slot có về 0 không
-
-    for (int i = 0; i < MAX_PRIO; i++) {
-        if (!empty(&mlq_ready_queue[i])) {
-            if (mlq_ready_queue[i].time_slot > 0) {
-                proc = dequeue(&mlq_ready_queue[i]);
-                mlq_ready_queue[i].time_slot--;
-                all_slots_empty = 0; // Có ít nhất một queue còn time slot
+    int max = 0;
+    int i;
+
+    for (i = 0; i < nr_rqs; i++) {
+        int n = atomic_load(&rqs[i].nr_ready);
+        if (&rqs[i] != self && n > max) {
+            busiest = &rqs[i];
+            max = n;
+        }
+    }
+    if (busiest == NULL)
+        return NULL;
+
+    rq_lock(busiest);
+    proc = policy->steal(busiest, self);
+    if (proc != NULL)
+        rq_taken(busiest, proc);
+    rq_unlock(busiest);
+
+    if (proc != NULL) {
+        /* Only the owner of [self] updates these two */
+        atomic_fetch_add(&self->nr_dispatch, 1);
+        self->nr_stolen++;
+    }
+    return proc;
+}
+
+/* Move processes from the busiest run queue to the idlest one until
+ * their loads are as close as they get */
+static void balance(uint64_t now) {
+    struct sched_rq * busiest = &rqs[0], * idlest = &rqs[0];
+    long load, total = 0, max, min, diff;
+    int i, moved = 0;
+
+    for (i = 0; i < nr_rqs; i++) {
+        load = atomic_load(&rqs[i].load);
+        total += load;
+        if (load > atomic_load(&busiest->load))
+            busiest = &rqs[i];
+        if (load < atomic_load(&idlest->load))
+            idlest = &rqs[i];
+    }
+    if (total == 0)
+        return;
+    max = atomic_load(&busiest->load);
+    min = atomic_load(&idlest->load);
+    diff = max - min;
+    /* Imbalance in percent of the average load */
+    load = diff * 100 * nr_rqs / total;
+
+    nr_balance++;
+    if (load > balance_threshold) {
+        /* The balancer is the only one holding two queue locks, the
+         * order does not matter */
+        rq_lock(busiest);
+        rq_lock(idlest);
+        while (diff > 0) {
+            /* Look before taking: a process that stays keeps its place
+             * and, under CFS, its vruntime */
+            struct pcb_t * proc = policy->peek(busiest);
+            /* It would leave the queues further apart than now */
+            if (proc == NULL || SCHED_WEIGHT(proc) >= diff)
                 break;
-            }
-        } else {
-            empty_queue++;
+            /* Without locks another CPU may have taken it in between,
+             * the one we get instead is moved all the same */
+            if ((proc = policy->steal(busiest, idlest)) == NULL)
+                break;
+            rq_taken(busiest, proc);
+            rq_enqueue(idlest, proc, 0);
+            idlest->nr_pulled++;
+            diff -= 2 * SCHED_WEIGHT(proc);
+            moved++;
         }
+        rq_unlock(idlest);
+        rq_unlock(busiest);
     }
+    if (moved == 0)
+        return;
+    nr_balance_moved++;
+    nr_balance_procs += moved;
+    printf("\tBalancer: slot %lu, rq %d load %ld, rq %d load %ld, imbalance %ld%%, moved %d\n",
+        now, (int)(busiest - rqs), max, (int)(idlest - rqs), min, load,
+        moved);
+}
 
-    // Nếu tất cả time slot về 0, reset lại cho từng hàng đợi
-    if (all_slots_empty) {
-        for (int j = 0; j < MAX_PRIO; j++) {
-            mlq_ready_queue[j].time_slot = MAX_PRIO - j;
+/* Account for [proc] being dispatched on the calling CPU */
+static void track_cpu(struct pcb_t * proc) {
+    if (this_cpu < 0)
+        return;
+    if (proc->last_cpu >= 0 && proc->last_cpu != this_cpu) {
+        proc->nr_migrations++;
+        proc->warmup = migration_cost;
+        atomic_fetch_add(&nr_migrations, 1);
+    }
+    proc->last_cpu = this_cpu;
+}
+
+static int cmp_u64(const void * a, const void * b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_pid(const void * a, const void * b) {
+    const struct exit_stat * x = a, * y = b;
+    return (x->pid > y->pid) - (x->pid < y->pid);
+}
+
+static void print_exits(void) {
+    uint64_t * turnaround;
+    uint64_t sum = 0;
+    int i, n = nr_exits;
+    if (n == 0)
+        return;
+    qsort(exits, n, sizeof(struct exit_stat), cmp_pid);
+    turnaround = malloc(n * sizeof(uint64_t));
+    for (i = 0; i < n; i++) {
+        printf("\tprocess %2u: turnaround %4lu, %2u migrations",
+            exits[i].pid, exits[i].turnaround, exits[i].nr_migrations);
+        if (exits[i].rt_period > 0)
+            printf(", %2u deadline misses", exits[i].rt_missed);
+        if (quantum_max > 0 && exits[i].nr_slices > 0)
+            printf(", %3u slices of %u to %u slots", exits[i].nr_slices,
+                exits[i].quantum_lo, exits[i].quantum_hi);
+        printf("\n");
+        turnaround[i] = exits[i].turnaround;
+        sum += turnaround[i];
+    }
+    qsort(turnaround, n, sizeof(uint64_t), cmp_u64);
+    printf("\tturnaround of %d processes: mean %.1f p50 %lu p95 %lu p99 %lu max %lu\n",
+        n, (double)sum / n, turnaround[n / 2], turnaround[(n * 95) / 100],
+        turnaround[(n * 99) / 100], turnaround[n - 1]);
+    free(turnaround);
+}
+
+int queue_empty(void) {
+    return atomic_load(&nr_queued) == 0 && atomic_load(&nr_blocked) == 0 &&
+        !rt_pending();
+}
+
+void sched_use_percpu(int ncpus) {
+    nr_rqs = (ncpus > 1) ? ncpus : 1;
+}
+
+void sched_set_nr_cpus(int ncpus) {
+    nr_cpus = (ncpus > 1) ? ncpus : 1;
+}
+
+void sched_set_cpu(int cpu) {
+    this_cpu = cpu;
+}
+
+int sched_set_policy(const char * name) {
+    unsigned int i;
+    for (i = 0; i < NR_SCHED_CLASSES; i++) {
+        if (!strcmp(name, sched_classes[i]->name)) {
+            policy = sched_classes[i];
+            return 0;
         }
     }
+    return -1;
+}
 
-    pthread_mutex_unlock(&queue_lock);
-    return proc;
+void sched_set_capacity(int nprocs) {
+    if (nprocs > capacity)
+        capacity = nprocs;
 }
 
-void put_mlq_proc(struct pcb_t * proc) {
-    pthread_mutex_lock(&queue_lock);
-    enqueue(&mlq_ready_queue[proc->prio], proc);
-    pthread_mutex_unlock(&queue_lock);
+void sched_set_migration_cost(int slots) {
+    migration_cost = (slots > 0) ? slots : 0;
 }
 
-void add_mlq_proc(struct pcb_t * proc) {
-    pthread_mutex_lock(&queue_lock);
-    enqueue(&mlq_ready_queue[proc->prio], proc);
-    pthread_mutex_unlock(&queue_lock);
+void sched_set_balance(int interval, int threshold) {
+    balance_interval = (interval > 0) ? interval : 0;
+    if (threshold >= 0)
+        balance_threshold = threshold;
 }
 
-struct pcb_t * get_proc(void) {
-    return get_mlq_proc();
+int sched_capacity(void) {
+    return capacity;
 }
 
-void put_proc(struct pcb_t * proc) {
-    /*proc->ready_queue = &ready_queue;
-    *proc->mlq_ready_queue = mlq_ready_queue;
-    *proc->running_list = &running_list;*/
-    
+int sched_policy_percpu(void) {
+    return sched_class()->percpu;
+}
+
+int sched_rt_admit(struct pcb_t * proc) {
+    return rt_admit(proc, nr_cpus);
+}
+
+int sched_preempt(struct pcb_t * proc) {
+    return rt_preempt(proc);
+}
+
+void sched_set_quantum(int min, int max, int spread) {
+    quantum_min = (min < 1) ? 1 : min;
+    quantum_max = (max < quantum_min && max > 0) ? quantum_min : max;
+    quantum_spread = (spread < 0) ? 0 : spread;
+}
+
+int sched_quantum(struct pcb_t * proc, int slot) {
+    if (quantum_max == 0 || proc->rt_period > 0)
+        return slot;
+    if (proc->quantum == 0) {
+        proc->quantum = (slot < quantum_min) ? quantum_min :
+            (slot > quantum_max) ? quantum_max : slot;
+        proc->quantum_lo = proc->quantum_hi = proc->quantum;
+    }
+    proc->nr_slices++;
+    return proc->quantum;
+}
+
+void sched_slice_end(struct pcb_t * proc, int ran, int io, int expired) {
+    uint32_t q = proc->quantum;
+    if (quantum_max == 0 || proc->rt_period > 0 || q == 0)
+        return;
+    if (2 * io > ran) {
+        /* Mostly waiting on the system, let it in often and briefly */
+        q = (q / 2 < (uint32_t)quantum_min) ? (uint32_t)quantum_min : q / 2;
+#ifdef MLQ_SCHED
+        if (proc->prio > 0 && proc->prio + quantum_spread > proc->base_prio)
+            proc->prio--;
+#endif
+    } else if (expired) {
+        /* Bound by the CPU, switch it less often */
+        q = (2 * q > (uint32_t)quantum_max) ? (uint32_t)quantum_max : 2 * q;
+#ifdef MLQ_SCHED
+        if (proc->prio < MAX_PRIO - 1 &&
+                proc->prio < proc->base_prio + quantum_spread)
+            proc->prio++;
+#endif
+    }
+    proc->quantum = q;
+    if (q < proc->quantum_lo)
+        proc->quantum_lo = q;
+    if (q > proc->quantum_hi)
+        proc->quantum_hi = q;
+}
+
+void sched_account(struct pcb_t * proc, int ticks) {
+    if (ticks <= 0)
+        return;
+    if (proc->rt_period > 0) {
+        rt_tick(proc, ticks);
+    } else if (policy->on_tick != NULL)
+        policy->on_tick(cpu_rq(), proc, ticks);
+}
+
+int sched_batch(struct pcb_t * proc, int max) {
+    uint64_t now = current_time();
+    uint64_t next = rt_release_time();
+
+    if (proc->rt_period > 0)
+        return 0;
+    if (balance_interval > 0 && nr_rqs > 1 &&
+            atomic_load(&next_balance) < next)
+        next = atomic_load(&next_balance);
+    if (next <= now + 1)
+        return 0;
+    return (next - now - 1 < (uint64_t)max) ? (int)(next - now - 1) : max;
+}
+
+int sched_batch_over(uint64_t end) {
+    if (balance_interval > 0 && nr_rqs > 1 &&
+            atomic_load(&next_balance) < end)
+        return 1;
+    return rt_release_time() < end;
+}
+
+void sched_tick(struct pcb_t * proc, int ticks) {
+    sched_account(proc, ticks);
+    if (balance_interval > 0 && nr_rqs > 1) {
+        uint64_t now = current_time();
+        uint64_t next = atomic_load(&next_balance);
+        /* The first CPU past the due slot runs the pass */
+        if (now >= next && atomic_compare_exchange_strong(&next_balance,
+                &next, now + balance_interval))
+            balance(now);
+    }
+}
+
+int sched_remove(struct pcb_t * proc) {
+    struct sched_rq * rq;
+    int found = 0;
+    if (proc->rt_period > 0)
+        return rt_remove(proc);
+    if (policy->remove == NULL)
+        return 0;
+    /* It may move to another queue before we get the lock */
+    while ((rq = proc->rq) != NULL) {
+        rq_lock(rq);
+        if (proc->rq == rq) {
+            found = policy->remove(rq, proc);
+            if (found)
+                rq_taken(rq, proc);
+            rq_unlock(rq);
+            break;
+        }
+        rq_unlock(rq);
+    }
+    return found;
+}
+
+void sched_kill(struct pcb_t * proc) {
+    proc->state = PROC_KILLED;
+}
+
+int sched_block(struct pcb_t * proc) {
+    uint32_t ready = PROC_READY;
+    if (!atomic_compare_exchange_strong(&proc->state, &ready, PROC_BLOCKED))
+        return -1;
+    atomic_fetch_add(&nr_blocked, 1);
+    return 0;
+}
+
+void sched_wake(struct pcb_t * proc) {
+    uint32_t blocked = PROC_BLOCKED;
+    atomic_compare_exchange_strong(&proc->state, &blocked, PROC_READY);
+    /* Queued first, so the CPUs never see nothing left in between */
+    put_proc(proc);
+    atomic_fetch_sub(&nr_blocked, 1);
+}
+
+void sched_for_each_proc(void (*fn)(struct pcb_t *, void *), void * arg) {
+    struct pcb_t * proc, * next;
     pthread_mutex_lock(&queue_lock);
-    enqueue(&running_list, proc);
+    list_for_each_entry_safe(proc, next, &all_procs, all_node) {
+        fn(proc, arg);
+    }
     pthread_mutex_unlock(&queue_lock);
-
-    put_mlq_proc(proc);
 }
 
-void add_proc(struct pcb_t * proc) {
-    /*proc->ready_queue = &ready_queue;
-    *proc->mlq_ready_queue = mlq_ready_queue;
-    *proc->running_list = &running_list;*/
-    
+void sched_proc_exit(struct pcb_t * proc) {
+    if (proc->rt_period > 0)
+        rt_exit(proc);
     pthread_mutex_lock(&queue_lock);
-    enqueue(&running_list, proc);
+    list_del_init(&proc->all_node);
+    if (nr_exits == max_exits) {
+        max_exits = max_exits ? 2 * max_exits : 64;
+        exits = realloc(exits, max_exits * sizeof(struct exit_stat));
+    }
+    exits[nr_exits].pid = proc->pid;
+    exits[nr_exits].nr_migrations = proc->nr_migrations;
+    exits[nr_exits].rt_period = proc->rt_period;
+    exits[nr_exits].rt_missed = proc->rt_missed;
+    exits[nr_exits].quantum_lo = proc->quantum_lo;
+    exits[nr_exits].quantum_hi = proc->quantum_hi;
+    exits[nr_exits].nr_slices = proc->nr_slices;
+    exits[nr_exits].turnaround = current_time() - proc->arrival;
+    nr_exits++;
     pthread_mutex_unlock(&queue_lock);
+}
 
-    add_mlq_proc(proc);
+void init_scheduler(void) {
+    int i;
+    policy = sched_class();
+    rqs = calloc(nr_rqs, sizeof(struct sched_rq));
+    for (i = 0; i < nr_rqs; i++) {
+        pthread_mutex_init(&rqs[i].lock, NULL);
+        policy->init(&rqs[i]);
+    }
+    atomic_store(&nr_queued, 0);
+    atomic_store(&next_balance, balance_interval);
+    pthread_mutex_init(&queue_lock, NULL);
+}
+
+void finish_scheduler(void) {
+    int i;
+    for (i = 0; i < nr_rqs; i++) {
+        policy->fini(&rqs[i]);
+        pthread_mutex_destroy(&rqs[i].lock);
+    }
+    free(rqs);
+    rqs = NULL;
+    free(exits);
+    exits = NULL;
+    nr_exits = max_exits = 0;
+    atomic_store(&nr_migrations, 0);
+    nr_balance = nr_balance_moved = nr_balance_procs = 0;
+    INIT_LIST_HEAD(&all_procs);
+    rt_fini();
+    pthread_mutex_destroy(&queue_lock);
+}
+
+void print_sched_stats(void) {
+    unsigned long locks = 0, contended = 0, stolen = 0;
+    int i;
+    printf("Scheduler: %s %s run queue%s\n",
+        (nr_rqs > 1) ? "per-CPU" : "global", policy->name,
+        (nr_rqs > 1) ? "s" : "");
+    for (i = 0; i < nr_rqs; i++) {
+        struct sched_rq * rq = &rqs[i];
+        printf("\trq %2d: %6lu dispatches %6lu stolen %6lu pulled %8lu locks %6lu contended\n",
+            i, atomic_load(&rq->nr_dispatch), rq->nr_stolen, rq->nr_pulled,
+            rq->nr_locks, rq->nr_contended);
+        if (policy->stats != NULL)
+            policy->stats(rq);
+        locks += rq->nr_locks;
+        contended += rq->nr_contended;
+        stolen += rq->nr_stolen;
+    }
+    printf("\ttotal: %lu stolen, %lu migrations, %lu of %lu lock acquisitions contended\n",
+        stolen, atomic_load(&nr_migrations), contended, locks);
+    if (nr_balance > 0)
+        printf("\tbalancer: %lu passes, %lu of them moved %lu processes\n",
+            nr_balance, nr_balance_moved, nr_balance_procs);
+    rt_stats();
+    print_exits();
 }
-#else
+
 struct pcb_t * get_proc(void) {
-    struct pcb_t * proc = NULL;
-    pthread_mutex_lock(&queue_lock);
-    if (!empty(&ready_queue)) {
-        proc = dequeue(&ready_queue);
+    struct sched_rq * rq = cpu_rq();
+    struct pcb_t * proc;
+
+    /* Real-time processes go first */
+    if ((proc = rt_pick()) != NULL) {
+        track_cpu(proc);
+        return proc;
     }
-    pthread_mutex_unlock(&queue_lock);
+
+    rq_lock(rq);
+    if (nr_rqs > 1 && atomic_load(&rq->nr_ready) == 0) {
+        rq_unlock(rq);
+        proc = steal_proc(rq);
+    } else {
+        proc = rq_pick(rq);
+        rq_unlock(rq);
+    }
+    if (proc != NULL)
+        track_cpu(proc);
     return proc;
 }
 
+/* A process goes back to the queue of the CPU it ran on */
 void put_proc(struct pcb_t * proc) {
-    /*proc->ready_queue = &ready_queue;
-    *proc->running_list = &running_list;*/
-    
-    pthread_mutex_lock(&queue_lock);
-    enqueue(&ready_queue, proc);
-    enqueue(&run_queue, proc);
-    pthread_mutex_unlock(&queue_lock);
+    /* The process is already on all_procs since add_proc() */
+    struct sched_rq * rq = cpu_rq();
+    if (proc->rt_period > 0) {
+        rt_enqueue(proc, 0);
+        return;
+    }
+    rq_lock(rq);
+    rq_enqueue(rq, proc, 0);
+    rq_unlock(rq);
 }
 
+/* A new process goes to the least loaded queue */
 void add_proc(struct pcb_t * proc) {
-    /*proc->ready_queue = &ready_queue;
-    *proc->running_list = &running_list;*/
-    
+    struct sched_rq * rq = &rqs[0];
+    int i;
+
     pthread_mutex_lock(&queue_lock);
-    enqueue(&running_list, proc);
-    enqueue(&ready_queue, proc);
+    list_add_tail(&proc->all_node, &all_procs);
     pthread_mutex_unlock(&queue_lock);
-}
+
+    for (i = 1; i < nr_rqs; i++) {
+        if (atomic_load(&rqs[i].nr_ready) < atomic_load(&rq->nr_ready))
+            rq = &rqs[i];
+    }
+    proc->arrival = current_time();
+    proc->last_cpu = -1;
+#ifdef MLQ_SCHED
+    proc->base_prio = proc->prio;
 #endif
+    if (proc->rt_period > 0) {
+        rt_enqueue(proc, ENQUEUE_NEW);
+        return;
+    }
+    rq_lock(rq);
+    rq_enqueue(rq, proc, ENQUEUE_NEW);
+    rq_unlock(rq);
+}
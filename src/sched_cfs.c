@@ -0,0 +1,140 @@
+#include "sched_class.h"
+
+#ifdef MLQ_SCHED
+/* Completely fair policy. The process that had the least weighted CPU
+ * time runs next. */
+
+/* A process of weight w ages CFS_NICE0 / w virtual units per slot it
+ * runs */
+#define CFS_NICE0 ((uint64_t)MAX_PRIO << 10)
+
+static int cfs_before(struct pcb_t * a, struct pcb_t * b) {
+    if (a->vruntime != b->vruntime)
+        return a->vruntime < b->vruntime;
+    return a->pid < b->pid;
+}
+
+/* Top-down skew heap merge without recursion. The result is a child of
+ * [parent], NULL when it is the root. */
+static struct pcb_t * cfs_merge(struct pcb_t * a, struct pcb_t * b,
+        struct pcb_t * parent) {
+    struct pcb_t * root = NULL;
+    struct pcb_t ** link = &root;
+    while (a != NULL && b != NULL) {
+        if (cfs_before(b, a)) {
+            struct pcb_t * t = a;
+            a = b;
+            b = t;
+        }
+        /* Merge into the right child, then swap the children */
+        *link = a;
+        a->cfs_parent = parent;
+        struct pcb_t * next = a->cfs_right;
+        a->cfs_right = a->cfs_left;
+        link = &a->cfs_left;
+        parent = a;
+        a = next;
+    }
+    *link = (a != NULL) ? a : b;
+    if (*link != NULL)
+        (*link)->cfs_parent = parent;
+    return root;
+}
+
+static void cfs_init(struct sched_rq * rq) {
+}
+
+static void cfs_fini(struct sched_rq * rq) {
+    rq->cfs.root = NULL;
+}
+
+static void cfs_enqueue(struct sched_rq * rq, struct pcb_t * proc, int flags) {
+    /* Start even with the processes already there */
+    if (flags & ENQUEUE_NEW)
+        proc->vruntime = rq->cfs.min_vruntime;
+    proc->cfs_left = proc->cfs_right = NULL;
+    rq->cfs.root = cfs_merge(rq->cfs.root, proc, NULL);
+}
+
+static struct pcb_t * cfs_dequeue(struct cfs_rq * cfs) {
+    struct pcb_t * proc = cfs->root;
+    if (proc == NULL)
+        return NULL;
+    cfs->root = cfs_merge(proc->cfs_left, proc->cfs_right, NULL);
+    if (proc->vruntime > cfs->min_vruntime)
+        cfs->min_vruntime = proc->vruntime;
+    return proc;
+}
+
+/* The children of the root are the next best candidates, take one of
+ * them if it ran on [cpu] and the root did not */
+static struct pcb_t * cfs_pick_next(struct sched_rq * rq, int cpu) {
+    struct pcb_t * root = rq->cfs.root;
+    struct pcb_t * proc;
+    if (cpu >= 0 && root != NULL && root->last_cpu != cpu) {
+        proc = root->cfs_left;
+        if (proc != NULL && proc->last_cpu == cpu) {
+            root->cfs_left = cfs_merge(proc->cfs_left, proc->cfs_right,
+                    root);
+            return proc;
+        }
+        proc = root->cfs_right;
+        if (proc != NULL && proc->last_cpu == cpu) {
+            root->cfs_right = cfs_merge(proc->cfs_left, proc->cfs_right,
+                    root);
+            return proc;
+        }
+    }
+    return cfs_dequeue(&rq->cfs);
+}
+
+static struct pcb_t * cfs_steal(struct sched_rq * rq, struct sched_rq * to) {
+    struct pcb_t * proc = cfs_dequeue(&rq->cfs);
+    /* Keep its lead or lag over the queue it leaves */
+    if (proc != NULL)
+        proc->vruntime += to->cfs.min_vruntime - rq->cfs.min_vruntime;
+    return proc;
+}
+
+static struct pcb_t * cfs_peek(struct sched_rq * rq) {
+    return rq->cfs.root;
+}
+
+static void cfs_on_tick(struct sched_rq * rq, struct pcb_t * proc, int ticks) {
+    /* Per slot, so a batch of slots ages it as much as one at a time */
+    proc->vruntime += ticks * (CFS_NICE0 / SCHED_WEIGHT(proc));
+}
+
+/* Put the merged children of [proc] where it hangs. They are not
+ * before its parent, so the order holds. */
+static int cfs_remove(struct sched_rq * rq, struct pcb_t * proc) {
+    struct pcb_t * parent = proc->cfs_parent;
+    struct pcb_t * sub = cfs_merge(proc->cfs_left, proc->cfs_right, parent);
+
+    if (parent == NULL)
+        rq->cfs.root = sub;
+    else if (parent->cfs_left == proc)
+        parent->cfs_left = sub;
+    else
+        parent->cfs_right = sub;
+    return 1;
+}
+
+static void cfs_stats(struct sched_rq * rq) {
+    printf("\t       min vruntime %lu\n", rq->cfs.min_vruntime);
+}
+
+const struct sched_class cfs_sched_class = {
+    .name = "cfs",
+    .percpu = 1,
+    .init = cfs_init,
+    .fini = cfs_fini,
+    .enqueue = cfs_enqueue,
+    .pick_next = cfs_pick_next,
+    .steal = cfs_steal,
+    .peek = cfs_peek,
+    .on_tick = cfs_on_tick,
+    .remove = cfs_remove,
+    .stats = cfs_stats,
+};
+#endif
@@ -0,0 +1,65 @@
+#include "sched_class.h"
+
+/* Round robin in arrival order, priorities are ignored. The queue is a
+ * list threaded through the processes, so any of them can be taken out
+ * in O(1). */
+
+static void fifo_init(struct sched_rq * rq) {
+    INIT_LIST_HEAD(&rq->fifo.queue);
+}
+
+static void fifo_fini(struct sched_rq * rq) {
+    INIT_LIST_HEAD(&rq->fifo.queue);
+}
+
+static void fifo_enqueue(struct sched_rq * rq, struct pcb_t * proc, int flags) {
+    list_add_tail(&proc->rq_node, &rq->fifo.queue);
+}
+
+static struct pcb_t * fifo_take(struct pcb_t * proc) {
+    list_del_init(&proc->rq_node);
+    return proc;
+}
+
+static struct pcb_t * fifo_pick_next(struct sched_rq * rq, int cpu) {
+    struct pcb_t * proc, * next;
+    int i = 0;
+    if (list_empty(&rq->fifo.queue))
+        return NULL;
+    if (cpu >= 0) {
+        list_for_each_entry_safe(proc, next, &rq->fifo.queue, rq_node) {
+            if (i++ == AFFINITY_WINDOW)
+                break;
+            if (proc->last_cpu == cpu)
+                return fifo_take(proc);
+        }
+    }
+    return fifo_take(list_first_entry(&rq->fifo.queue, struct pcb_t, rq_node));
+}
+
+static struct pcb_t * fifo_steal(struct sched_rq * rq, struct sched_rq * to) {
+    return fifo_pick_next(rq, -1);
+}
+
+static struct pcb_t * fifo_peek(struct sched_rq * rq) {
+    if (list_empty(&rq->fifo.queue))
+        return NULL;
+    return list_first_entry(&rq->fifo.queue, struct pcb_t, rq_node);
+}
+
+static int fifo_remove(struct sched_rq * rq, struct pcb_t * proc) {
+    fifo_take(proc);
+    return 1;
+}
+
+const struct sched_class fifo_sched_class = {
+    .name = "fifo",
+    .percpu = 0,
+    .init = fifo_init,
+    .fini = fifo_fini,
+    .enqueue = fifo_enqueue,
+    .pick_next = fifo_pick_next,
+    .steal = fifo_steal,
+    .peek = fifo_peek,
+    .remove = fifo_remove,
+};
@@ -0,0 +1,135 @@
+#include "sched_class.h"
+
+#ifdef MLQ_SCHED
+/* Multi-level queue. Level i is served up to MAX_PRIO - i times before
+ * the levels after it get their turn, then every budget is refilled. */
+
+/* Give every level its budget back. Only the bitmap is touched here,
+ * the time slots are reset by mlq_budget() when their level is next
+ * served. */
+static void mlq_refill(struct mlq_rq * mlq) {
+    mlq->epoch++;
+    fill_bitmap_ull(mlq->budget_map, MAX_PRIO);
+}
+
+/* Time slots of level [prio] in the current epoch */
+static int * mlq_budget(struct mlq_rq * mlq, int prio) {
+    if (mlq->slot_epoch[prio] != mlq->epoch) {
+        mlq->slot_epoch[prio] = mlq->epoch;
+        mlq->time_slot[prio] = MAX_PRIO - prio;
+    }
+    return &mlq->time_slot[prio];
+}
+
+static void mlq_init(struct sched_rq * rq) {
+    int i;
+    for (i = 0; i < MAX_PRIO; i++) {
+        INIT_LIST_HEAD(&rq->mlq.queue[i]);
+    }
+    /* Epoch 0 is the one every level starts in, before it is reset */
+    rq->mlq.epoch = 1;
+    fill_bitmap_ull(rq->mlq.budget_map, MAX_PRIO);
+}
+
+static void mlq_fini(struct sched_rq * rq) {
+    int i;
+    for (i = 0; i < MAX_PRIO; i++) {
+        INIT_LIST_HEAD(&rq->mlq.queue[i]);
+    }
+}
+
+/* A level only holds processes of one priority, so arrival order is
+ * priority order and a list does. Any process can be taken out in O(1). */
+static void mlq_enqueue(struct sched_rq * rq, struct pcb_t * proc, int flags) {
+    list_add_tail(&proc->rq_node, &rq->mlq.queue[proc->prio]);
+    set_bit_ull(proc->prio, rq->mlq.ready_map);
+}
+
+static struct pcb_t * mlq_take(struct mlq_rq * mlq, struct pcb_t * proc) {
+    list_del_init(&proc->rq_node);
+    if (list_empty(&mlq->queue[proc->prio]))
+        clear_bit_ull(proc->prio, mlq->ready_map);
+    return proc;
+}
+
+static struct pcb_t * mlq_dequeue(struct mlq_rq * mlq, int prio, int cpu) {
+    struct list_head * q = &mlq->queue[prio];
+    struct pcb_t * proc, * next;
+    int i = 0;
+    if (cpu >= 0) {
+        /* Stay inside the level, the budgets are not bent */
+        list_for_each_entry_safe(proc, next, q, rq_node) {
+            if (i++ == AFFINITY_WINDOW)
+                break;
+            if (proc->last_cpu == cpu)
+                return mlq_take(mlq, proc);
+        }
+    }
+    return mlq_take(mlq, list_first_entry(q, struct pcb_t, rq_node));
+}
+
+/* Serve the highest priority level that is both ready and has time
+ * slots. When every ready level has used up its slots, the budgets are
+ * refilled and the highest ready level is served. */
+static struct pcb_t * mlq_pick_next(struct sched_rq * rq, int cpu) {
+    struct mlq_rq * mlq = &rq->mlq;
+    struct pcb_t * proc;
+    int i = find_first_and_bit_ull(mlq->ready_map, mlq->budget_map, MAX_PRIO);
+    if (i == MAX_PRIO) {
+        i = find_first_bit_ull(mlq->ready_map, MAX_PRIO);
+        if (i == MAX_PRIO)
+            return NULL;
+        mlq_refill(mlq);
+        mlq->nr_refill++;
+    }
+    proc = mlq_dequeue(mlq, i, cpu);
+    mlq->nr_served[i]++;
+    if (--*mlq_budget(mlq, i) == 0) {
+        clear_bit_ull(i, mlq->budget_map);
+        mlq->nr_spent[i]++;
+    }
+    return proc;
+}
+
+/* The first process of the highest ready level, budgets are left to the
+ * CPUs that own the queue */
+static struct pcb_t * mlq_steal(struct sched_rq * rq, struct sched_rq * to) {
+    int i = find_first_bit_ull(rq->mlq.ready_map, MAX_PRIO);
+    return (i < MAX_PRIO) ? mlq_dequeue(&rq->mlq, i, -1) : NULL;
+}
+
+static struct pcb_t * mlq_peek(struct sched_rq * rq) {
+    int i = find_first_bit_ull(rq->mlq.ready_map, MAX_PRIO);
+    return (i < MAX_PRIO) ?
+        list_first_entry(&rq->mlq.queue[i], struct pcb_t, rq_node) : NULL;
+}
+
+static int mlq_remove(struct sched_rq * rq, struct pcb_t * proc) {
+    mlq_take(&rq->mlq, proc);
+    return 1;
+}
+
+static void mlq_stats(struct sched_rq * rq) {
+    int i;
+    printf("\t       %6lu budget refills\n", rq->mlq.nr_refill);
+    for (i = 0; i < MAX_PRIO; i++) {
+        if (rq->mlq.nr_served[i] == 0)
+            continue;
+        printf("\t       level %3d: %6lu dispatches, budget of %3d used up %6lu times\n",
+            i, rq->mlq.nr_served[i], MAX_PRIO - i, rq->mlq.nr_spent[i]);
+    }
+}
+
+const struct sched_class mlq_sched_class = {
+    .name = "mlq",
+    .percpu = 0,
+    .init = mlq_init,
+    .fini = mlq_fini,
+    .enqueue = mlq_enqueue,
+    .pick_next = mlq_pick_next,
+    .steal = mlq_steal,
+    .peek = mlq_peek,
+    .remove = mlq_remove,
+    .stats = mlq_stats,
+};
+#endif
@@ -0,0 +1,176 @@
+#include "sched_class.h"
+#include <stdlib.h>
+
+#ifdef MLQ_SCHED
+/* Multi-level queue without locks. Each level is a lock-free FIFO and
+ * the ready and budget bitmaps are updated with atomic operations, so
+ * the CPUs never wait for each other to dispatch or put back a process.
+ * The budgets are approximate when several CPUs use them at once. */
+
+/* Give every level its budget back, like mlq_refill(): a new epoch,
+ * then the budget bitmap a word at a time. The epoch goes first so a
+ * CPU seeing a refilled bit also sees the epoch its slots belong to. */
+static void mlq_lf_refill(struct mlq_lf_rq * lf) {
+    atomic_fetch_add(&lf->epoch, 1);
+    fill_bitmap_ull_atomic(lf->budget_map, MAX_PRIO);
+}
+
+/* Use a time slot of level [prio] and return how many are left. Slots
+ * tagged with an older epoch count as a full budget. */
+static int mlq_lf_charge(struct mlq_lf_rq * lf, int prio) {
+    uint64_t epoch = atomic_load(&lf->epoch);
+    uint64_t old = atomic_load(&lf->time_slot[prio]);
+    uint32_t left;
+
+    do {
+        left = (old >> 32 == epoch) ? (uint32_t)old : MAX_PRIO - prio;
+        if (left > 0)
+            left--;
+    } while (!atomic_compare_exchange_weak(&lf->time_slot[prio], &old,
+            epoch << 32 | left));
+    return left;
+}
+
+/* Queue of level [prio], the first caller allocates it */
+static struct lfq_t * mlq_lf_level(struct mlq_lf_rq * lf, int prio) {
+    struct lfq_t * q = atomic_load(&lf->level[prio]);
+    if (q == NULL) {
+        struct lfq_t * fresh = aligned_alloc(64, sizeof(struct lfq_t));
+        lfq_init(fresh, sched_capacity());
+        if (atomic_compare_exchange_strong(&lf->level[prio], &q, fresh)) {
+            q = fresh;
+        } else {
+            lfq_free(fresh);
+            free(fresh);
+        }
+    }
+    return q;
+}
+
+/* Clear the ready bit of a level found empty. A process put there in
+ * the meantime has set the bit before we cleared it, so look again. */
+static void mlq_lf_settle(struct mlq_lf_rq * lf, int prio) {
+    clear_bit_ull_atomic(prio, lf->ready_map);
+    if (!lfq_empty(atomic_load(&lf->level[prio])))
+        set_bit_ull_atomic(prio, lf->ready_map);
+}
+
+static void mlq_lf_init(struct sched_rq * rq) {
+    /* Epoch 0 is the one every level starts in, before it is reset */
+    atomic_store(&rq->mlq_lf.epoch, 1);
+    fill_bitmap_ull_atomic(rq->mlq_lf.budget_map, MAX_PRIO);
+}
+
+static void mlq_lf_fini(struct sched_rq * rq) {
+    int i;
+    for (i = 0; i < MAX_PRIO; i++) {
+        struct lfq_t * q = atomic_load(&rq->mlq_lf.level[i]);
+        if (q != NULL) {
+            lfq_free(q);
+            free(q);
+        }
+    }
+}
+
+static void mlq_lf_enqueue(struct sched_rq * rq, struct pcb_t * proc,
+        int flags) {
+    struct lfq_t * q = mlq_lf_level(&rq->mlq_lf, proc->prio);
+    /* The level holds every process, it is only full while a consumer
+     * is still releasing the cell we need */
+    while (lfq_push(q, proc) < 0);
+    set_bit_ull_atomic(proc->prio, rq->mlq_lf.ready_map);
+}
+
+/* Only the head of a level can be taken, there is no affinity */
+static struct pcb_t * mlq_lf_pick_next(struct sched_rq * rq, int cpu) {
+    struct mlq_lf_rq * lf = &rq->mlq_lf;
+    uint64_t ready[BITS_TO_ULLS(MAX_PRIO)];
+    uint64_t budget[BITS_TO_ULLS(MAX_PRIO)];
+    struct pcb_t * proc;
+    int i;
+
+    load_bitmap_ull(ready, lf->ready_map, MAX_PRIO);
+    load_bitmap_ull(budget, lf->budget_map, MAX_PRIO);
+    i = find_first_and_bit_ull(ready, budget, MAX_PRIO);
+    if (i == MAX_PRIO) {
+        /* Same as the locked MLQ: when every ready level used up its
+         * slots, refill and serve the highest ready one. CPUs that get
+         * here at once may each refill, which only makes the budgets
+         * more approximate. */
+        i = find_first_bit_ull(ready, MAX_PRIO);
+        if (i == MAX_PRIO)
+            return NULL;
+        mlq_lf_refill(lf);
+        atomic_fetch_add(&lf->nr_refill, 1);
+        load_bitmap_ull(budget, lf->budget_map, MAX_PRIO);
+        i = find_first_and_bit_ull(ready, budget, MAX_PRIO);
+        if (i == MAX_PRIO)
+            return NULL;
+    }
+
+    /* A level may look ready while its last process is being taken or
+     * its first one is still being put, skip it rather than wait */
+    while ((proc = lfq_pop(atomic_load(&lf->level[i]))) == NULL) {
+        mlq_lf_settle(lf, i);
+        clear_bit_ull(i, ready);
+        i = find_first_and_bit_ull(ready, budget, MAX_PRIO);
+        if (i == MAX_PRIO)
+            return NULL;
+    }
+    if (mlq_lf_charge(lf, i) == 0)
+        clear_bit_ull_atomic(i, lf->budget_map);
+    return proc;
+}
+
+static struct pcb_t * mlq_lf_steal(struct sched_rq * rq,
+        struct sched_rq * to) {
+    struct mlq_lf_rq * lf = &rq->mlq_lf;
+    uint64_t ready[BITS_TO_ULLS(MAX_PRIO)];
+    struct pcb_t * proc;
+    int i;
+
+    load_bitmap_ull(ready, lf->ready_map, MAX_PRIO);
+    while ((i = find_first_bit_ull(ready, MAX_PRIO)) < MAX_PRIO) {
+        proc = lfq_pop(atomic_load(&lf->level[i]));
+        if (proc != NULL)
+            return proc;
+        mlq_lf_settle(lf, i);
+        clear_bit_ull(i, ready);
+    }
+    return NULL;
+}
+
+static struct pcb_t * mlq_lf_peek(struct sched_rq * rq) {
+    struct mlq_lf_rq * lf = &rq->mlq_lf;
+    uint64_t ready[BITS_TO_ULLS(MAX_PRIO)];
+    struct pcb_t * proc;
+    int i;
+
+    load_bitmap_ull(ready, lf->ready_map, MAX_PRIO);
+    while ((i = find_first_bit_ull(ready, MAX_PRIO)) < MAX_PRIO) {
+        proc = lfq_peek(atomic_load(&lf->level[i]));
+        if (proc != NULL)
+            return proc;
+        clear_bit_ull(i, ready);
+    }
+    return NULL;
+}
+
+static void mlq_lf_stats(struct sched_rq * rq) {
+    printf("\t       %6lu budget refills\n",
+        atomic_load(&rq->mlq_lf.nr_refill));
+}
+
+const struct sched_class mlq_lf_sched_class = {
+    .name = "mlq_lf",
+    .percpu = 0,
+    .lockless = 1,
+    .init = mlq_lf_init,
+    .fini = mlq_lf_fini,
+    .enqueue = mlq_lf_enqueue,
+    .pick_next = mlq_lf_pick_next,
+    .steal = mlq_lf_steal,
+    .peek = mlq_lf_peek,
+    .stats = mlq_lf_stats,
+};
+#endif
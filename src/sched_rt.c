@@ -0,0 +1,252 @@
+#include "sched_class.h"
+#include "timer.h"
+#include <stdlib.h>
+
+/* Real-time tier, above whatever policy orders the other processes. A
+ * real-time process is entitled to rt_budget slots in every period of
+ * rt_period slots, its deadline is the end of the current period.
+ *
+ * Ready processes are kept in a heap ordered by deadline, the earliest
+ * one runs first on any CPU (global EDF). A process that used up its
+ * budget is throttled in a second heap until its deadline, then it
+ * starts a new period with a fresh budget. A period that ends with
+ * budget left is a deadline miss.
+ *
+ * The loader only admits a process while the sum of budget / period of
+ * the admitted ones stays under RT_UTIL_LIMIT per mille of each CPU, so
+ * the other processes keep the rest. */
+
+#define RT_UTIL_LIMIT 950
+
+struct rt_heap {
+    struct pcb_t ** proc;
+    int size;
+    int cap;
+};
+
+static pthread_mutex_t rt_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct rt_heap rt_ready;     // By deadline
+static struct rt_heap rt_throttled; // By deadline, which is also the release
+static long rt_util;                // Per mille of one CPU, admitted processes
+static _Atomic int nr_rt;           // Ready or throttled
+static _Atomic int nr_rt_ready;
+static _Atomic uint64_t rt_next_release = UINT64_MAX;
+static _Atomic uint64_t rt_next_deadline = UINT64_MAX;
+static unsigned long nr_rt_dispatch;
+static unsigned long nr_rt_missed;
+
+static int rt_before(struct pcb_t * a, struct pcb_t * b) {
+    if (a->rt_deadline != b->rt_deadline)
+        return a->rt_deadline < b->rt_deadline;
+    return a->pid < b->pid;
+}
+
+/* Put [proc] in node [i] of [h], where rt_remove() finds it */
+static void heap_set(struct rt_heap * h, int i, struct pcb_t * proc) {
+    h->proc[i] = proc;
+    proc->rt_index = i;
+}
+
+static void heap_push(struct rt_heap * h, struct pcb_t * proc) {
+    int i;
+    if (h->size == h->cap) {
+        h->cap = h->cap ? 2 * h->cap : QUEUE_INIT_SIZE;
+        h->proc = realloc(h->proc, h->cap * sizeof(struct pcb_t *));
+    }
+    for (i = h->size++; i > 0 && rt_before(proc, h->proc[(i - 1) / 2]);
+            i = (i - 1) / 2) {
+        heap_set(h, i, h->proc[(i - 1) / 2]);
+    }
+    heap_set(h, i, proc);
+}
+
+/* Take the process of node [i] out of [h] */
+static struct pcb_t * heap_take(struct rt_heap * h, int i) {
+    struct pcb_t * proc = h->proc[i];
+    struct pcb_t * last = h->proc[--h->size];
+    proc->rt_index = -1;
+    if (i == h->size)
+        return proc;
+    while (i > 0 && rt_before(last, h->proc[(i - 1) / 2])) {
+        heap_set(h, i, h->proc[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    while (2 * i + 1 < h->size) {
+        int child = 2 * i + 1;
+        if (child + 1 < h->size && rt_before(h->proc[child + 1], h->proc[child]))
+            child++;
+        if (!rt_before(h->proc[child], last))
+            break;
+        heap_set(h, i, h->proc[child]);
+        i = child;
+    }
+    heap_set(h, i, last);
+    return proc;
+}
+
+/* Start the periods of [proc] that began by [now] */
+static void rt_refresh(struct pcb_t * proc, uint64_t now) {
+    if (now < proc->rt_deadline)
+        return;
+    if (proc->rt_left > 0) {
+        proc->rt_missed++;
+        nr_rt_missed++;
+    }
+    while (proc->rt_deadline <= now) {
+        proc->rt_deadline += proc->rt_period;
+    }
+    proc->rt_left = proc->rt_budget;
+}
+
+/* Publish the heads of the heaps for rt_preempt() */
+static void rt_update_release(void) {
+    atomic_store(&rt_next_release, rt_throttled.size ?
+        rt_throttled.proc[0]->rt_deadline : UINT64_MAX);
+}
+
+static void rt_update_ready(void) {
+    atomic_store(&rt_next_deadline, rt_ready.size ?
+        rt_ready.proc[0]->rt_deadline : UINT64_MAX);
+}
+
+/* Queue [proc] where it belongs, with rt_lock held */
+static void rt_queue(struct pcb_t * proc, uint64_t now) {
+    rt_refresh(proc, now);
+    if (proc->rt_left == 0) {
+        heap_push(&rt_throttled, proc);
+        rt_update_release();
+    } else {
+        heap_push(&rt_ready, proc);
+        atomic_fetch_add(&nr_rt_ready, 1);
+        rt_update_ready();
+    }
+}
+
+int rt_admit(struct pcb_t * proc, int ncpus) {
+    long util;
+    int ok;
+    if (proc->rt_budget == 0 || proc->rt_budget > proc->rt_period) {
+        proc->rt_period = proc->rt_budget = 0;
+        return -1;
+    }
+    util = proc->rt_budget * 1000L / proc->rt_period;
+    pthread_mutex_lock(&rt_lock);
+    ok = (rt_util + util <= (long)ncpus * RT_UTIL_LIMIT);
+    if (ok)
+        rt_util += util;
+    pthread_mutex_unlock(&rt_lock);
+    if (!ok)
+        proc->rt_period = proc->rt_budget = 0;
+    return ok ? 0 : -1;
+}
+
+void rt_enqueue(struct pcb_t * proc, int flags) {
+    uint64_t now = current_time();
+    pthread_mutex_lock(&rt_lock);
+    if (flags & ENQUEUE_NEW) {
+        proc->rt_deadline = now + proc->rt_period;
+        proc->rt_left = proc->rt_budget;
+        atomic_fetch_add(&nr_rt, 1);
+    }
+    rt_queue(proc, now);
+    pthread_mutex_unlock(&rt_lock);
+}
+
+struct pcb_t * rt_pick(void) {
+    uint64_t now = current_time();
+    struct pcb_t * proc = NULL;
+
+    if (atomic_load(&nr_rt_ready) == 0 && atomic_load(&rt_next_release) > now)
+        return NULL;
+    pthread_mutex_lock(&rt_lock);
+    /* Release the processes whose new period has begun */
+    while (rt_throttled.size > 0 && rt_throttled.proc[0]->rt_deadline <= now) {
+        rt_queue(heap_take(&rt_throttled, 0), now);
+    }
+    rt_update_release();
+    /* A period may have ended while it waited */
+    while (rt_ready.size > 0) {
+        proc = heap_take(&rt_ready, 0);
+        atomic_fetch_sub(&nr_rt_ready, 1);
+        if (now < proc->rt_deadline)
+            break;
+        rt_queue(proc, now);
+        proc = NULL;
+    }
+    if (proc != NULL)
+        nr_rt_dispatch++;
+    rt_update_ready();
+    pthread_mutex_unlock(&rt_lock);
+    return proc;
+}
+
+void rt_tick(struct pcb_t * proc, int ticks) {
+    proc->rt_left = (proc->rt_left > (uint32_t)ticks) ?
+        proc->rt_left - ticks : 0;
+}
+
+int rt_preempt(struct pcb_t * proc) {
+    uint64_t now;
+    if (atomic_load(&nr_rt) == 0)
+        return 0;
+    now = current_time();
+    /* A released process is only known to be ready once somebody
+     * dispatches, assume the worst about its deadline */
+    if (atomic_load(&rt_next_release) <= now)
+        return 1;
+    if (proc->rt_period > 0)
+        return proc->rt_left == 0 || now >= proc->rt_deadline ||
+            atomic_load(&rt_next_deadline) < proc->rt_deadline;
+    return atomic_load(&nr_rt_ready) > 0;
+}
+
+int rt_pending(void) {
+    return atomic_load(&nr_rt) > 0;
+}
+
+uint64_t rt_release_time(void) {
+    return atomic_load(&rt_next_release);
+}
+
+int rt_remove(struct pcb_t * proc) {
+    int i, found = 1;
+    pthread_mutex_lock(&rt_lock);
+    i = proc->rt_index;
+    if (i >= 0 && i < rt_ready.size && rt_ready.proc[i] == proc) {
+        heap_take(&rt_ready, i);
+        atomic_fetch_sub(&nr_rt_ready, 1);
+        rt_update_ready();
+    } else if (i >= 0 && i < rt_throttled.size && rt_throttled.proc[i] == proc) {
+        heap_take(&rt_throttled, i);
+        rt_update_release();
+    } else
+        found = 0;
+    pthread_mutex_unlock(&rt_lock);
+    return found;
+}
+
+void rt_exit(struct pcb_t * proc) {
+    pthread_mutex_lock(&rt_lock);
+    rt_util -= proc->rt_budget * 1000L / proc->rt_period;
+    atomic_fetch_sub(&nr_rt, 1);
+    pthread_mutex_unlock(&rt_lock);
+}
+
+void rt_fini(void) {
+    free(rt_ready.proc);
+    free(rt_throttled.proc);
+    rt_ready = rt_throttled = (struct rt_heap){ 0 };
+    rt_util = 0;
+    nr_rt_dispatch = nr_rt_missed = 0;
+    atomic_store(&nr_rt, 0);
+    atomic_store(&nr_rt_ready, 0);
+    atomic_store(&rt_next_release, UINT64_MAX);
+    atomic_store(&rt_next_deadline, UINT64_MAX);
+}
+
+void rt_stats(void) {
+    if (nr_rt_dispatch == 0)
+        return;
+    printf("\treal-time: %lu dispatches, %lu deadline misses\n",
+        nr_rt_dispatch, nr_rt_missed);
+}
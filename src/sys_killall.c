@@ -12,94 +12,80 @@
 #include "syscall.h"
 #include "stdio.h"
 #include "libmem.h"
-#include "queue.h"
+#include "mm.h"
+#include "sched.h"
+#include "loader.h"
+#include "list.h"
 #include <string.h>
 
+struct killall_args {
+    const char *name;
+    int nr_killed;
+    struct list_head queued; // Taken out of the run queues, on rq_node
+};
+
+/* Match either the whole program path or its last component */
+static void kill_if_named(struct pcb_t *proc, void *arg)
+{
+    struct killall_args *args = arg;
+    const char *base = strrchr(proc->path, '/');
+
+    base = (base != NULL) ? base + 1 : proc->path;
+    if (proc->state != PROC_KILLED &&
+            (strcmp(proc->path, args->name) == 0 ||
+             strcmp(base, args->name) == 0)) {
+        sched_kill(proc);
+        args->nr_killed++;
+        /* Nobody runs a queued one, it does not wait for a CPU to
+         * dispatch it only to free it */
+        if (sched_remove(proc))
+            list_add_tail(&proc->rq_node, &args->queued);
+    }
+}
+
 int __sys_killall(struct pcb_t *caller, struct sc_regs* regs)
 {
     char proc_name[100];
-    uint32_t data;
+    struct vm_rg_struct *rg;
+    uint32_t len = 0, n;
+    char *end = NULL;
 
     //hardcode for demo only
     uint32_t memrg = regs->a1;
     
-    /* TODO: Get name of the target proc */ 
-    //proc_name = libread..
-    int i = 0;
-    data = 0;
-    while(data != -1){
-        libread(caller, memrg, i, &data);
-        proc_name[i]= data;
-        if(data == -1) proc_name[i]='\0';
-        i++;
+    /* The name ends with a -1 byte. Read it a page at a time instead of
+     * byte by byte, without going past the page that holds the end. */
+    rg = get_symrg_byid(caller->mm, memrg);
+    while (rg != NULL && end == NULL && len < sizeof(proc_name) - 1) {
+        n = PAGING_PAGESZ - PAGING_OFFST((rg->rg_start + len));
+        if (n > sizeof(proc_name) - 1 - len)
+            n = sizeof(proc_name) - 1 - len;
+        /* Never match on part of the name. If a page is not in yet,
+         * the process is blocked and the call runs again once it is */
+        if (libread_range(caller, memrg, len, (BYTE *)proc_name + len, n) != 0)
+            return -1;
+        end = memchr(proc_name + len, -1, n);
+        len += n;
     }
+    proc_name[len] = '\0';
+    if (end != NULL)
+        *end = '\0';
     printf("The procname retrieved from memregionid %d is \"%s\"\n", memrg, proc_name);
     
-    /* TODO: Traverse proclist to terminate the proc
-     *       strcmp to check the process match proc_name
-     */
-    //caller->running_list
-    //caller->mlq_ready_queue
-
-    /* TODO Maching and terminating 
-     *       all processes with given
-     *        name in var proc_name
-     */
-
-    if (caller->running_list != NULL) {
-        struct queue_t *running_list = caller->running_list;
-        struct queue_t temp_queue = {.size = 0};  
-        
-        while (!empty(running_list)) { // Extract all processes from running_list
-            struct pcb_t *proc = dequeue(running_list); // dequeue: terminate process
-            
-            if (strcmp(proc->path, proc_name) != 0) { // name doesn't match: keep process
-                enqueue(&temp_queue, proc);
-            }
-        }
-
-        while (!empty(&temp_queue)) { // Re-add the processes into the queue
-            enqueue(running_list, dequeue(&temp_queue));
-        }
+    /* Every live process is on the list of the scheduler. The queued
+     * ones matching are freed here, once the list is let go of. The
+     * running or blocked ones are only marked: the CPU that looks at
+     * one next frees it. Matching is O(1) per process. */
+    struct killall_args args = { proc_name, 0 };
+    struct pcb_t *proc, *next;
+    INIT_LIST_HEAD(&args.queued);
+    sched_for_each_proc(kill_if_named, &args);
+    list_for_each_entry_safe(proc, next, &args.queued, rq_node) {
+        list_del_init(&proc->rq_node);
+        printf("\tProcess %2d was killed while queued\n", proc->pid);
+        sched_proc_exit(proc);
+        unload(proc);
     }
 
-    /* if (caller->ready_queue != NULL) {
-        struct queue_t *ready_queue = caller->ready_queue;
-        struct queue_t temp_queue = {.size = 0};  
-        
-        while (!empty(ready_queue)) { 
-            struct pcb_t *proc = dequeue(ready_queue); 
-            
-            if (strcmp(proc->path, proc_name) != 0) { 
-                enqueue(&temp_queue, proc);
-            }
-        }
-
-        while (!empty(&temp_queue)) { 
-            enqueue(ready_queue, dequeue(&temp_queue));
-        }
-    } */ // Not sure if needed
-
-    #ifdef MLQ_SCHED
-        for (int i = 0; i < MAX_PRIO; i++){
-            if (caller->mlq_ready_queue != NULL){
-                struct queue_t *priority_queue = &caller->mlq_ready_queue[i];
-                struct queue_t temp_queue = { .size = 0};
-                while (!empty(priority_queue)){
-                    struct pcb_t *proc = dequeue(priority_queue);
-                    
-                    if (strcmp(proc->path, proc_name) != 0) { 
-                        enqueue(&temp_queue, proc);
-                    }
-                }
-
-                while (!empty(&temp_queue)) { 
-                    enqueue(priority_queue, dequeue(&temp_queue));
-                }
-            }
-        }
-        
-    #endif
-
     return 0; 
 }
@@ -1,95 +1,272 @@
-
 #include "timer.h"
+#include <semaphore.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+/* Number of polling rounds a device spends on the generation flag
+ * before it parks itself and waits to be woken up */
+#define TIMER_SPIN_LIMIT 1024
 
-static pthread_t _timer;
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() do { } while (0)
+#endif
 
 struct timer_id_container_t {
 	struct timer_id_t id;
+	sem_t back;	// Posted when an away device is counted in again
+	struct timer_id_container_t * back_next;
 	struct timer_id_container_t * next;
 };
 
 static struct timer_id_container_t * dev_list = NULL;
+static uint32_t nr_devs = 0;
 
-static uint64_t _time;
+static _Atomic uint64_t _time;
 
 static int timer_started = 0;
-static int timer_stop = 0;
-
-
-static void * timer_routine(void * args) {
-	while (!timer_stop) {
-		printf("Time slot %3lu\n", current_time());
-		int fsh = 0;
-		int event = 0;
-		/* Wait for all devices have done the job in current
-		 * time slot */
-		struct timer_id_container_t * temp;
-		for (temp = dev_list; temp != NULL; temp = temp->next) {
-			pthread_mutex_lock(&temp->id.event_lock);
-			while (!temp->id.done && !temp->id.fsh) {
-				pthread_cond_wait(
-					&temp->id.event_cond,
-					&temp->id.event_lock
-				);
-			}
-			if (temp->id.fsh) {
-				fsh++;
-			}
-			event++;
-			pthread_mutex_unlock(&temp->id.event_lock);
+
+/* Barrier word of the clock. The upper half holds the number of devices
+ * still attached, the lower half how many of them already arrived in the
+ * current slot. Arrivals and detaches update it with a single atomic
+ * operation, so exactly one device sees the slot complete and releases
+ * it. */
+#define BARRIER_ONE_DEV		(1ULL << 32)
+#define BARRIER_ARRIVED(s)	((uint32_t)(s))
+#define BARRIER_DEVS(s)		((uint32_t)((s) >> 32))
+
+static _Atomic uint64_t barrier;
+
+/* Devices that arrived idle in the current slot */
+static _Atomic uint32_t nr_idle;
+
+/* Devices that left the barrier for a few slots, see next_slots() */
+static _Atomic uint32_t nr_away;
+
+/* Generation of the current slot, its lowest bit is the sense. It is
+ * bumped each time a slot is released. Waiting devices only watch it
+ * change, so a new slot never has to touch the device list. */
+static _Atomic unsigned int generation;
+
+/* Devices that gave up spinning sleep on the semaphore of the sense
+ * they are waiting on. nr_parked[] tells the releaser how many tokens to
+ * post. POSIX semaphores are a thin wrapper around a futex, calling the
+ * futex directly is not an option since the simulated syscall() shadows
+ * the libc one. */
+static sem_t park_sem[2];
+static _Atomic int nr_parked[2];
+
+/* Spinning only pays off when the releasing device can run at the same
+ * time, on a single core it just burns the time slice of the host */
+static int spin_limit;
+
+/* Earliest slot in which an attached device has work again if all the
+ * devices in the barrier are idle, TIMER_NEVER otherwise */
+static uint64_t idle_wake(uint64_t state) {
+	struct timer_id_container_t * temp;
+	uint64_t wake = TIMER_NEVER;
+
+	if (atomic_load(&nr_idle) != BARRIER_DEVS(state)) {
+		return TIMER_NEVER;
+	}
+	for (temp = dev_list; temp != NULL; temp = temp->next) {
+		uint64_t next = temp->id.resume ? temp->id.resume :
+			temp->id.wake;
+		if (!temp->id.fsh && next < wake) {
+			wake = next;
+		}
+	}
+	return wake;
+}
+
+/* Count back in the away devices whose last slot is over when the clock
+ * reaches [now], or that want to come back early. They are chained on
+ * [list] to be woken up once the slot is released. Return how many
+ * rejoined the barrier. */
+static uint32_t rejoin_devices(uint64_t now,
+		struct timer_id_container_t ** list) {
+	struct timer_id_container_t * temp;
+	uint32_t back = 0;
+
+	*list = NULL;
+	if (atomic_load(&nr_away) == 0) {
+		return 0;
+	}
+	for (temp = dev_list; temp != NULL; temp = temp->next) {
+		if (temp->id.resume != 0 && (temp->id.resume <= now ||
+				(temp->id.recall != NULL &&
+				 temp->id.recall(temp->id.recall_arg, now)))) {
+			temp->id.resume = 0;
+			temp->back_next = *list;
+			*list = temp;
+			back++;
 		}
+	}
+	atomic_fetch_sub(&nr_away, back);
+	return back;
+}
+
+/* Release the current slot. Called by the device whose arrival (or
+ * detach) completed the barrier, every other attached device is
+ * waiting on [gen] at this point. */
+static void release_slot(uint64_t state, unsigned int gen) {
+	uint64_t now = atomic_load(&_time) + 1;
+	uint64_t wake = idle_wake(state);
+	struct timer_id_container_t * back;
+	struct timer_id_container_t * next;
+	uint32_t devs;
+	int sense = gen & 1;
+	int parked;
 
-		/* Increase the time slot */
-		_time++;
-		
-		/* Let devices continue their job */
-		for (temp = dev_list; temp != NULL; temp = temp->next) {
-			pthread_mutex_lock(&temp->id.timer_lock);
-			temp->id.done = 0;
-			pthread_cond_signal(&temp->id.timer_cond);
-			pthread_mutex_unlock(&temp->id.timer_lock);
+	/* Nobody can change anything before the earliest wake time, so the
+	 * slots in between are only printed, not synchronized */
+	if (wake != TIMER_NEVER) {
+		for (; now < wake; now++) {
+			printf("Time slot %3lu\n", now);
 		}
-		if (fsh == event) {
+	}
+
+	/* Increase the time slot, the recalls look at the new one */
+	atomic_store(&_time, now);
+	devs = BARRIER_DEVS(state) + rejoin_devices(now, &back);
+	atomic_store(&nr_idle, 0);
+	atomic_store(&barrier, (uint64_t)devs << 32);
+	if (devs > 0) {
+		printf("Time slot %3lu\n", now);
+	}
+
+	/* Let devices continue their job */
+	atomic_store(&generation, gen + 1);
+	parked = atomic_exchange(&nr_parked[sense], 0);
+	while (parked-- > 0) {
+		sem_post(&park_sem[sense]);
+	}
+
+	/* Away devices sleep on their own semaphore, a device that skips
+	 * slots must not take the token of one waiting in a later slot of
+	 * the same sense. A woken device may leave again and reuse its
+	 * back_next link, so it is read before the post */
+	while (back != NULL) {
+		next = back->back_next;
+		sem_post(&back->back);
+		back = next;
+	}
+}
+
+/* Wait for the slot identified by [gen] to be released */
+static void wait_slot(unsigned int gen) {
+	int sense = gen & 1;
+	int spin;
+
+	for (spin = 0; spin < spin_limit; spin++) {
+		if (atomic_load_explicit(&generation,
+				memory_order_acquire) != gen) {
+			return;
+		}
+		cpu_relax();
+	}
+
+	/* We register before re-checking the flag and the releaser reads
+	 * the counter after flipping it, so a sleeping device is always
+	 * counted. Releasers that left the barrier may post late and hand
+	 * a token to a waiter of a later slot of the same sense, such a
+	 * waiter registers again before going back to sleep. */
+	while (1) {
+		atomic_fetch_add(&nr_parked[sense], 1);
+		if (atomic_load(&generation) != gen) {
+			break;
+		}
+		sem_wait(&park_sem[sense]);
+		if (atomic_load(&generation) != gen) {
 			break;
 		}
 	}
-	pthread_exit(args);
 }
 
 void next_slot(struct timer_id_t * timer_id) {
 	/* Tell to timer that we have done our job in current slot */
-	pthread_mutex_lock(&timer_id->event_lock);
-	timer_id->done = 1;
-	pthread_cond_signal(&timer_id->event_cond);
-	pthread_mutex_unlock(&timer_id->event_lock);
+	unsigned int gen = atomic_load(&generation);
+	uint64_t state = atomic_fetch_add(&barrier, 1) + 1;
+
+	if (BARRIER_ARRIVED(state) == BARRIER_DEVS(state)) {
+		/* We are the last one, move the clock forward */
+		release_slot(state, gen);
+		return;
+	}
 
 	/* Wait for going to next slot */
-	pthread_mutex_lock(&timer_id->timer_lock);
-	while (timer_id->done) {
-		pthread_cond_wait(
-			&timer_id->timer_cond,
-			&timer_id->timer_lock
-		);
-	}
-	pthread_mutex_unlock(&timer_id->timer_lock);
+	wait_slot(gen);
+}
+
+void next_slot_idle(struct timer_id_t * timer_id, uint64_t wake) {
+	timer_id->wake = wake;
+	atomic_fetch_add(&nr_idle, 1);
+	next_slot(timer_id);
+}
+
+void next_slots(struct timer_id_t * timer_id, uint64_t nslots) {
+	uint64_t resume = current_time() + nslots;
+	unsigned int gen;
+	uint64_t state;
+
+	if (nslots <= 1) {
+		next_slot(timer_id);
+		return;
+	}
+
+	/* Leave the barrier as if detaching, the releaser of the slot
+	 * before [resume] counts us in again and wakes us up */
+	timer_id->resume = resume;
+	atomic_fetch_add(&nr_away, 1);
+	gen = atomic_load(&generation);
+	state = atomic_fetch_sub(&barrier, BARRIER_ONE_DEV) - BARRIER_ONE_DEV;
+	if (BARRIER_ARRIVED(state) == BARRIER_DEVS(state)) {
+		release_slot(state, gen);
+	}
+
+	while (sem_wait(&((struct timer_id_container_t *)timer_id)->back)) {
+		/* Interrupted, keep waiting */
+	}
+}
+
+void set_recall(struct timer_id_t * timer_id,
+		int (*recall)(void * arg, uint64_t slot), void * arg) {
+	timer_id->recall = recall;
+	timer_id->recall_arg = arg;
 }
 
 uint64_t current_time() {
-	return _time;
+	return atomic_load_explicit(&_time, memory_order_relaxed);
+}
+
+void set_current_time(uint64_t now) {
+	atomic_store(&_time, now);
 }
 
 void start_timer() {
 	timer_started = 1;
-	pthread_create(&_timer, NULL, timer_routine, NULL);
+	spin_limit = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? TIMER_SPIN_LIMIT : 0;
+	sem_init(&park_sem[0], 0, 0);
+	sem_init(&park_sem[1], 0, 0);
+	atomic_store(&barrier, (uint64_t)nr_devs << 32);
+	printf("Time slot %3lu\n", current_time());
 }
 
 void detach_event(struct timer_id_t * event) {
-	pthread_mutex_lock(&event->event_lock);
+	unsigned int gen = atomic_load(&generation);
+	uint64_t state;
+
 	event->fsh = 1;
-	pthread_cond_signal(&event->event_cond);
-	pthread_mutex_unlock(&event->event_lock);
+	state = atomic_fetch_sub(&barrier, BARRIER_ONE_DEV) - BARRIER_ONE_DEV;
+
+	/* The remaining devices may all be waiting for us */
+	if ((BARRIER_DEVS(state) > 0 || atomic_load(&nr_away) > 0) &&
+			BARRIER_ARRIVED(state) == BARRIER_DEVS(state)) {
+		release_slot(state, gen);
+	}
 }
 
 struct timer_id_t * attach_event() {
@@ -98,14 +275,13 @@ struct timer_id_t * attach_event() {
 	}else{
 		struct timer_id_container_t * container =
 			(struct timer_id_container_t*)malloc(
-				sizeof(struct timer_id_container_t)		
+				sizeof(struct timer_id_container_t)
 			);
-		container->id.done = 0;
 		container->id.fsh = 0;
-		pthread_cond_init(&container->id.event_cond, NULL);
-		pthread_mutex_init(&container->id.event_lock, NULL);
-		pthread_cond_init(&container->id.timer_cond, NULL);
-		pthread_mutex_init(&container->id.timer_lock, NULL);
+		container->id.wake = TIMER_NEVER;
+		container->id.resume = 0;
+		container->id.recall = NULL;
+		sem_init(&container->back, 0, 0);
 		if (dev_list == NULL) {
 			dev_list = container;
 			dev_list->next = NULL;
@@ -113,24 +289,25 @@ struct timer_id_t * attach_event() {
 			container->next = dev_list;
 			dev_list = container;
 		}
+		nr_devs++;
 		return &(container->id);
 	}
 }
 
 void stop_timer() {
-	timer_stop = 1;
-	pthread_join(_timer, NULL);
 	while (dev_list != NULL) {
 		struct timer_id_container_t * temp = dev_list;
 		dev_list = dev_list->next;
-		pthread_cond_destroy(&temp->id.event_cond);
-		pthread_mutex_destroy(&temp->id.event_lock);
-		pthread_cond_destroy(&temp->id.timer_cond);
-		pthread_mutex_destroy(&temp->id.timer_lock);
+		sem_destroy(&temp->back);
 		free(temp);
 	}
+	sem_destroy(&park_sem[0]);
+	sem_destroy(&park_sem[1]);
+	atomic_store(&nr_away, 0);
+	atomic_store(&nr_parked[0], 0);
+	atomic_store(&nr_parked[1], 0);
+	nr_devs = 0;
+	timer_started = 0;
+	atomic_store(&_time, 0);
 }
 
-
-
-
@@ -0,0 +1,138 @@
+#include "tlb.h"
+#include "mm.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef MM_PAGING
+#define TLB_SETS 16
+#define TLB_WAYS 4
+
+/* An entry packs its tag and its frame in one word, so the CPU that
+ * owns it never reads one torn by a shootdown:
+ *   valid (1) | pid (32) | pgn (14) | fpn (13) */
+#define TLB_FPN_BITS (PAGING_PTE_FPN_HIBIT + 1)
+#define TLB_PGN_BITS (PAGING_CPU_BUS_WIDTH - NBITS(PAGING_PAGESZ))
+#define TLB_TAG(pid, pgn) (((uint64_t)1 << (32 + TLB_PGN_BITS)) | \
+	((uint64_t)(pid) << TLB_PGN_BITS) | (uint64_t)(pgn))
+#define TLB_SET(pid, pgn) (((pid) ^ (pgn)) & (TLB_SETS - 1))
+
+struct tlb {
+	_Atomic uint64_t entry[TLB_SETS][TLB_WAYS];
+	uint8_t next[TLB_SETS];	// Way replaced next, round robin
+	unsigned long nr_hits;
+	unsigned long nr_misses;
+	_Atomic unsigned long nr_shot;	// Entries dropped by shootdowns
+};
+
+static struct tlb * tlbs;
+static int nr_tlbs;
+static int walk_cost;
+static _Atomic unsigned long nr_shootdowns;
+
+static __thread struct tlb * this_tlb;
+
+void tlb_init(int ncpus, int walk) {
+	nr_tlbs = (walk > 0) ? ncpus : 0;
+	walk_cost = walk;
+	tlbs = nr_tlbs ? calloc(nr_tlbs, sizeof(struct tlb)) : NULL;
+}
+
+void tlb_fini(void) {
+	free(tlbs);
+	tlbs = NULL;
+	nr_tlbs = 0;
+	atomic_store(&nr_shootdowns, 0);
+}
+
+void tlb_set_cpu(int cpu) {
+	this_tlb = (cpu >= 0 && cpu < nr_tlbs) ? &tlbs[cpu] : NULL;
+}
+
+int tlb_lookup(uint32_t pid, int pgn, int * fpn) {
+	struct tlb * tlb = this_tlb;
+	_Atomic uint64_t * set;
+	uint64_t tag = TLB_TAG(pid, pgn), e;
+	int i;
+
+	if (tlb == NULL) {
+		return -1;
+	}
+	set = tlb->entry[TLB_SET(pid, pgn)];
+	for (i = 0; i < TLB_WAYS; i++) {
+		e = atomic_load_explicit(&set[i], memory_order_relaxed);
+		if ((e >> TLB_FPN_BITS) == tag) {
+			*fpn = e & ((1 << TLB_FPN_BITS) - 1);
+			tlb->nr_hits++;
+			return 0;
+		}
+	}
+	tlb->nr_misses++;
+	return -1;
+}
+
+void tlb_insert(uint32_t pid, int pgn, int fpn) {
+	struct tlb * tlb = this_tlb;
+	int s = TLB_SET(pid, pgn);
+
+	if (tlb == NULL) {
+		return;
+	}
+	atomic_store_explicit(&tlb->entry[s][tlb->next[s]],
+		(TLB_TAG(pid, pgn) << TLB_FPN_BITS) | (uint64_t)fpn,
+		memory_order_relaxed);
+	tlb->next[s] = (tlb->next[s] + 1) % TLB_WAYS;
+}
+
+/* Only the CPU running the process uses its entries and the page table
+ * changes under the same process, so by the time another CPU runs it
+ * the scheduler locks have ordered the shootdown before its lookups */
+void tlb_shootdown(uint32_t pid, int pgn) {
+	uint64_t tag = TLB_TAG(pid, pgn), e;
+	int s = TLB_SET(pid, pgn);
+	int c, i;
+
+	if (nr_tlbs == 0) {
+		return;
+	}
+	atomic_fetch_add(&nr_shootdowns, 1);
+	for (c = 0; c < nr_tlbs; c++) {
+		for (i = 0; i < TLB_WAYS; i++) {
+			e = atomic_load_explicit(&tlbs[c].entry[s][i],
+				memory_order_relaxed);
+			if ((e >> TLB_FPN_BITS) == tag &&
+					atomic_compare_exchange_strong(
+					&tlbs[c].entry[s][i], &e, 0)) {
+				atomic_fetch_add(&tlbs[c].nr_shot, 1);
+			}
+		}
+	}
+}
+
+void tlb_stats(void) {
+	unsigned long hits = 0, misses = 0;
+	int c;
+
+	for (c = 0; c < nr_tlbs; c++) {
+		struct tlb * tlb = &tlbs[c];
+		unsigned long n = tlb->nr_hits + tlb->nr_misses;
+		if (n == 0) {
+			continue;
+		}
+		printf("TLB: CPU %d: %lu hits, %lu misses (%.1f%% hit rate), %lu shot down\n",
+			c, tlb->nr_hits, tlb->nr_misses,
+			100.0 * tlb->nr_hits / n, atomic_load(&tlb->nr_shot));
+		hits += tlb->nr_hits;
+		misses += tlb->nr_misses;
+	}
+	if (hits + misses == 0) {
+		return;
+	}
+	/* A miss pays the lookup and the page table walk */
+	printf("TLB: %lu shootdowns, %.2f cycles per translation modeled (hit 1, walk %d)\n",
+		atomic_load(&nr_shootdowns),
+		(double)(hits + misses * (1 + walk_cost)) / (hits + misses),
+		walk_cost);
+}
+#endif